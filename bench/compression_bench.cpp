@@ -0,0 +1,166 @@
+// Throughput and ratio of the object compressor over a mixed corpus.
+//
+//   compression_bench [file...]
+//
+// Without files the corpus is generated: source-like text, a repetitive
+// binary table, random bytes and an already deflated stream, which stand
+// in for code, build artifacts, encrypted data and media. Each row runs
+// the whole corpus through one backend at a fixed level; "auto" picks the
+// level per item with levelFor(), as object writes do. The "zlib" rows
+// call zlib's compress2() directly; when vit is built with libdeflate,
+// a "libdeflate" row through zlibCompress() follows each of them.
+
+#include "storage/compression.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <zlib.h>
+
+namespace {
+
+using vit::storage::levelFor;
+using vit::storage::zlibCompress;
+
+struct Item {
+    std::string name;
+    std::string data;
+};
+
+std::string sourceText(size_t size, std::mt19937& rng)
+{
+    static const char* const words[] = {
+        "const", "auto", "return", "if", "for", "std::string", "size_t", "id",
+        "object", "tree", "commit", "(", ")", "{", "}", ";", "=", "->", "::",
+    };
+    std::string out;
+    while (out.size() < size) {
+        out.append(rng() % 4 * 4, ' ');
+        for (unsigned n = 3 + rng() % 8; n; --n) {
+            out += words[rng() % std::size(words)];
+            out += ' ';
+        }
+        out += '\n';
+    }
+    out.resize(size);
+    return out;
+}
+
+std::string binaryTable(size_t size, std::mt19937& rng)
+{
+    std::string out;
+    while (out.size() < size) {
+        const uint32_t v = rng() % 1024;
+        out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+        out.append(12, '\0');
+    }
+    out.resize(size);
+    return out;
+}
+
+std::string randomBytes(size_t size, std::mt19937& rng)
+{
+    std::string out(size, '\0');
+    for (auto& c : out) c = static_cast<char>(rng());
+    return out;
+}
+
+std::string deflated(size_t size, std::mt19937& rng)
+{
+    // text compresses about 4:1, so four times as much goes in
+    std::string out;
+    zlibCompress(sourceText(size * 4, rng), 9, out);
+    out.resize(std::min(out.size(), size));
+    return out;
+}
+
+std::vector<Item> generatedCorpus()
+{
+    std::mt19937 rng(42);
+    std::vector<Item> corpus;
+    for (size_t size : { size_t(4) << 10, size_t(256) << 10, size_t(4) << 20 }) {
+        const std::string suffix = " " + std::to_string(size >> 10) + "K";
+        corpus.push_back({ "text" + suffix,     sourceText(size, rng) });
+        corpus.push_back({ "binary" + suffix,   binaryTable(size, rng) });
+        corpus.push_back({ "random" + suffix,   randomBytes(size, rng) });
+        corpus.push_back({ "deflated" + suffix, deflated(size, rng) });
+    }
+    return corpus;
+}
+
+using Compress = bool (*)(std::string_view data, int level, std::string& out);
+
+bool zlibOnly(std::string_view data, int level, std::string& out)
+{
+    uLongf size = compressBound(data.size());
+    out.resize(size);
+    if (compress2(reinterpret_cast<Bytef*>(out.data()), &size,
+                  reinterpret_cast<const Bytef*>(data.data()), data.size(), level) != Z_OK)
+        return false;
+    out.resize(size);
+    return true;
+}
+
+// -2 stands for "auto"
+void run(const std::vector<Item>& corpus, const char* backend, Compress compress, int level)
+{
+    size_t in = 0, out = 0;
+    std::string compressed;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < 3; ++round) {
+        for (const auto& item : corpus) {
+            if (!compress(item.data, level == -2 ? levelFor(item.data) : level, compressed)) {
+                std::fprintf(stderr, "compression failed: %s\n", item.name.c_str());
+                return;
+            }
+            in  += item.data.size();
+            out += compressed.size();
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    char label[8];
+    if (level == -2) std::snprintf(label, sizeof(label), "auto");
+    else             std::snprintf(label, sizeof(label), "%d", level);
+    std::printf("%-6s %-11s %10.1f MiB/s %8.3f\n", label, backend, in / seconds / (1 << 20),
+                static_cast<double>(out) / static_cast<double>(in));
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::vector<Item> corpus;
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream f(argv[i], std::ios::binary);
+        if (!f) {
+            std::fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+        corpus.push_back({ argv[i], std::string(std::istreambuf_iterator<char>(f), {}) });
+    }
+    if (corpus.empty()) corpus = generatedCorpus();
+
+    size_t total = 0, stored = 0;
+    for (const auto& item : corpus) {
+        total += item.data.size();
+        if (levelFor(item.data) == 0) ++stored;
+    }
+    std::printf("backend %s (zlib %s), %zu items, %.1f MiB, %zu stored by auto\n",
+                vit::storage::compressionBackend(), zlibVersion(), corpus.size(),
+                total / double(1 << 20), stored);
+    const bool libdeflate = std::string_view(vit::storage::compressionBackend()) == "libdeflate";
+    std::printf("%-6s %-11s %16s %8s\n", "level", "backend", "throughput", "ratio");
+    for (int level : { 0, 1, 3, 6, 9, -2 }) {
+        run(corpus, "zlib", zlibOnly, level);
+        if (libdeflate) run(corpus, "libdeflate", zlibCompress, level);
+    }
+    return 0;
+}
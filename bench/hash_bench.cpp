@@ -0,0 +1,122 @@
+// Throughput of object hashing for 1 KiB, 64 KiB and 16 MiB objects.
+//
+//   hash_bench
+//
+// "concat" is how objects used to be named: the header and content joined
+// into a new string and passed to OpenSSL's SHA1(). The other rows hash
+// the two pieces with hashObject() on each backend this CPU supports;
+// "batch" names the same objects 256 at a time with hashObjects(), as tree
+// writes do for small files.
+
+#include "storage/sha1.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <openssl/sha.h>
+
+namespace {
+
+using vit::storage::HashBackend;
+using vit::storage::HashInput;
+using vit::storage::ObjectId;
+
+constexpr size_t TOTAL = size_t(256) << 20;   // bytes hashed per row
+constexpr size_t BATCH = 256;
+
+// every digest is folded in here, so that no hashing is optimised away
+volatile unsigned char sink;
+
+struct Corpus {
+    size_t                   size;
+    std::vector<std::string> headers, contents;
+};
+
+Corpus makeCorpus(size_t size, std::mt19937& rng)
+{
+    // enough distinct objects to leave the cache for the small sizes
+    Corpus c{ size, {}, {} };
+    const size_t count = std::max<size_t>(1, std::min<size_t>(BATCH * 4, (size_t(64) << 20) / size));
+    for (size_t i = 0; i < count; ++i) {
+        std::string content(size, '\0');
+        for (auto& ch : content) ch = static_cast<char>(rng());
+        c.headers.push_back("blob " + std::to_string(size) + '\0');
+        c.contents.push_back(std::move(content));
+    }
+    return c;
+}
+
+// Hashes objects of the corpus round-robin until TOTAL bytes went through.
+template <typename Hash>
+double throughput(const Corpus& c, Hash&& hash)
+{
+    const size_t rounds = std::max<size_t>(1, TOTAL / c.size);
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; ++i) sink = sink ^ hash(i % c.contents.size());
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return double(rounds) * double(c.size) / seconds / (1 << 20);
+}
+
+double batched(const Corpus& c)
+{
+    std::vector<HashInput> inputs;
+    for (size_t i = 0; i < c.contents.size(); ++i) inputs.push_back({ c.headers[i], c.contents[i] });
+
+    size_t hashed = 0, first = 0;
+    const auto start = std::chrono::steady_clock::now();
+    while (hashed < TOTAL) {
+        const size_t count = std::min(BATCH, inputs.size() - first);
+        const std::vector<HashInput> group(inputs.begin() + first, inputs.begin() + first + count);
+        for (const ObjectId& id : vit::storage::hashObjects(group)) sink = sink ^ id.data()[0];
+        hashed += count * c.size;
+        first   = (first + count) % inputs.size();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return double(hashed) / seconds / (1 << 20);
+}
+
+void run(const char* label, const std::vector<Corpus>& corpora, const auto& measure)
+{
+    std::printf("%-22s", label);
+    for (const auto& c : corpora) std::printf(" %12.1f", measure(c));
+    std::printf("  MiB/s\n");
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 rng(42);
+    std::vector<Corpus> corpora;
+    for (size_t size : { size_t(1) << 10, size_t(64) << 10, size_t(16) << 20 })
+        corpora.push_back(makeCorpus(size, rng));
+
+    std::printf("%-22s %12s %12s %12s\n", "", "1 KiB", "64 KiB", "16 MiB");
+    run("concat + SHA1()", corpora, [](const Corpus& c) {
+        return throughput(c, [&](size_t i) {
+            const std::string full = c.headers[i] + c.contents[i];
+            unsigned char sha[SHA_DIGEST_LENGTH];
+            SHA1(reinterpret_cast<const unsigned char*>(full.data()), full.size(), sha);
+            return sha[0];
+        });
+    });
+
+    const HashBackend detected = vit::storage::hashBackend();
+    for (HashBackend backend : { HashBackend::OpenSSL, HashBackend::ShaNi, HashBackend::ArmV8 }) {
+        if (!vit::storage::setHashBackend(backend)) continue;
+        const std::string name = vit::storage::hashBackendName(backend);
+        run((name + " hashObject").c_str(), corpora, [](const Corpus& c) {
+            return throughput(c, [&](size_t i) {
+                return vit::storage::hashObject(c.headers[i], c.contents[i]).data()[0];
+            });
+        });
+        run((name + (vit::storage::multiBufferHashing() ? " batch x8" : " batch")).c_str(), corpora, batched);
+    }
+    vit::storage::setHashBackend(detected);
+    std::printf("default backend: %s\n", vit::storage::hashBackendName(detected));
+    return 0;
+}
@@ -0,0 +1,108 @@
+// Random lookups in a pack .idx.
+//
+//   lookup_bench [objects]
+//
+// Writes a version 2 .idx for `objects` random names (1M by default) to
+// the temporary directory, maps it with PackIndex and times find() for
+// names in random order, then for names that are not in it. An
+// unordered_map over the same names is timed alongside for scale.
+
+#include "storage/pack_index.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using vit::storage::ObjectId;
+using vit::storage::PackIndex;
+using vit::storage::PackIndexEntry;
+
+constexpr size_t LOOKUPS = 1000000;
+
+// every result is folded in here, so that no lookup is optimised away
+volatile uint64_t sink;
+
+ObjectId randomId(std::mt19937_64& rng)
+{
+    unsigned char raw[ObjectId::RAW_SIZE];
+    for (auto& b : raw) b = static_cast<unsigned char>(rng());
+    return ObjectId::fromRaw(raw);
+}
+
+template <typename Find>
+void run(const char* label, const std::vector<ObjectId>& queries, Find&& find)
+{
+    size_t found = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& id : queries) {
+        uint64_t offset = 0;
+        if (find(id, offset)) ++found;
+        sink = sink + offset;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-24s %10.1f ns/lookup %10zu found\n", label, seconds * 1e9 / double(queries.size()), found);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    if (count == 0) {
+        std::fprintf(stderr, "usage: lookup_bench [objects]\n");
+        return 1;
+    }
+
+    std::mt19937_64 rng(42);
+    std::vector<PackIndexEntry> entries(count);
+    std::unordered_map<ObjectId, uint64_t> map;
+    map.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        entries[i].id     = randomId(rng);
+        entries[i].offset = 12 + 64 * uint64_t(i);
+        map.emplace(entries[i].id, entries[i].offset);
+    }
+
+    std::vector<ObjectId> hits, misses;
+    for (size_t i = 0; i < LOOKUPS; ++i) {
+        hits.push_back(entries[rng() % count].id);
+        misses.push_back(randomId(rng));
+    }
+
+    const std::string path = (std::filesystem::temp_directory_path() /
+                              ("lookup_bench_" + std::to_string(::getpid()) + ".idx")).string();
+    if (!PackIndex::write(path, std::move(entries), std::string(ObjectId::RAW_SIZE, '\0'))) {
+        std::fprintf(stderr, "cannot write %s\n", path.c_str());
+        return 1;
+    }
+    PackIndex index;
+    const bool opened = index.open(path);
+    std::error_code ec;
+    std::filesystem::remove(path, ec);   // the mapping stays valid
+    if (!opened) {
+        std::fprintf(stderr, "cannot open %s\n", path.c_str());
+        return 1;
+    }
+
+    std::printf("%zu objects, %zu lookups\n", index.objectCount(), LOOKUPS);
+    run("idx hits", hits, [&](const ObjectId& id, uint64_t& offset) { return index.find(id, offset); });
+    run("idx misses", misses, [&](const ObjectId& id, uint64_t& offset) { return index.find(id, offset); });
+    auto inMap = [&](const ObjectId& id, uint64_t& offset) {
+        const auto it = map.find(id);
+        if (it == map.end()) return false;
+        offset = it->second;
+        return true;
+    };
+    run("unordered_map hits", hits, inMap);
+    run("unordered_map misses", misses, inMap);
+    return 0;
+}
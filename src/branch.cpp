@@ -27,7 +27,7 @@ std::string getCurrentBranch() {
     return "";
 }
 
-bool updateBranch(const std::string& branchName, const std::string& commitHash) {
+bool updateBranch(const std::string& branchName, const vit::storage::ObjectId& commitHash) {
     std::string branchPath = ".git/refs/heads/" + branchName;
     std::filesystem::create_directories(".git/refs/heads");
     
@@ -54,7 +54,7 @@ bool switchToBranch(const std::string& branchName) {
     return true;
 }
 
-bool writeHeadAsBranch(const std::string& hash, const std::string& branch)
+bool writeHeadAsBranch(const vit::storage::ObjectId& hash, const std::string& branch)
 {
     const std::string refPath = ".git/refs/heads/" + branch;
     std::filesystem::create_directories(std::filesystem::path(refPath).parent_path());
@@ -1,13 +1,15 @@
 #pragma once
 #include <string>
 
+#include "storage/object_id.hpp"
+
 std::string getCurrentBranch();
 
 bool updateBranch(const std::string& branchName,
-                  const std::string& commitHash);
+                  const vit::storage::ObjectId& commitHash);
 
 bool switchToBranch(const std::string& branchName);
 
 // Convenience: write commit hash to <branch> and switch HEAD.
-bool writeHeadAsBranch(const std::string& commitHash,
+bool writeHeadAsBranch(const vit::storage::ObjectId& commitHash,
                        const std::string& branchName = "main");
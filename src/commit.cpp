@@ -1,281 +1,524 @@
 #include "commit.hpp"
+#include "storage/object_store.hpp"
+#include "storage/bloom_filter.hpp"
+#include "storage/commit_graph.hpp"
+#include "storage/commit_view.hpp"
+#include "storage/compression.hpp"
+#include "storage/index_file.hpp"
+#include "storage/known_objects.hpp"
+#include "storage/loose_object.hpp"
+#include "storage/sha1.hpp"
+#include "storage/tree_view.hpp"
+#include "utils/thread_pool.hpp"
 
 #include <iostream>
 #include <filesystem>
 #include <fstream>
-#include <sstream>
-#include <iomanip>
 #include <vector>
 #include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <atomic>
 #include <ctime>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <unordered_set>
 #include <queue>
 
-#include <zlib.h>
-#include <openssl/sha.h>
+#include <sys/stat.h>
 
 
-std::string decompressObject(const std::string& compressed)
+std::string binaryToHexString(const std::string& bin)
 {
-    z_stream strm{};
-    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
-    strm.avail_in = compressed.size();
-
-    if (inflateInit(&strm) != Z_OK) {
-        std::cerr << "inflateInit failed\n";
-        return {};
-    }
-
-    std::string out;
-    char buf[4096];
-
-    int ret;
-    do {
-        strm.next_out  = reinterpret_cast<Bytef*>(buf);
-        strm.avail_out = sizeof(buf);
-        ret = inflate(&strm, Z_NO_FLUSH);
-        if (ret != Z_OK && ret != Z_STREAM_END) {
-            std::cerr << "inflate error: " << ret << '\n';
-            inflateEnd(&strm);
-            return {};
-        }
-        out.append(buf, sizeof(buf) - strm.avail_out);
-    } while (ret != Z_STREAM_END);
+    std::string hex(bin.size() * 2, '\0');
+    vit::storage::encodeHex(reinterpret_cast<const unsigned char*>(bin.data()), bin.size(), hex.data());
+    return hex;
+}
 
-    inflateEnd(&strm);
-    return out;
+std::string getObjectPath(const ObjectId& id)
+{
+    // ".git/objects/" + 2 hex digits + '/' + 38 hex digits
+    char hex[ObjectId::HEX_SIZE];
+    vit::storage::encodeHex(id.data(), ObjectId::RAW_SIZE, hex);
+    std::string path = ".git/objects/";
+    path.reserve(path.size() + ObjectId::HEX_SIZE + 1);
+    path.append(hex, 2);
+    path += '/';
+    path.append(hex + 2, ObjectId::HEX_SIZE - 2);
+    return path;
 }
 
 
 
-std::string hashToHexString(const unsigned char* hash)
+ObjectId writeObject(const std::string& type, const std::string& content)
 {
-    std::ostringstream ss;
-    for (int i = 0; i < SHA_DIGEST_LENGTH; ++i)
-        ss << std::hex << std::setw(2) << std::setfill('0')
-           << static_cast<int>(hash[i]);
-    return ss.str();
+    const std::string header = type + ' ' + std::to_string(content.size()) + '\0';
+    return writeObject(type, content, vit::storage::hashObject(header, content));
 }
 
-std::string hexStringToBinary(const std::string& hex)
+ObjectId writeObject(const std::string& type, const std::string& content, const ObjectId& id)
 {
-    std::string bin;
-    for (int i = 0; i < 20; ++i) {
-        std::string byteStr = hex.substr(i * 2, 2);
-        char byte = static_cast<char>(std::stoi(byteStr, nullptr, 16));
-        bin += byte;
+    // already stored (or just stored by another thread): nothing to write
+    auto& known = vit::storage::KnownObjects::instance();
+    if (!known.claim(id)) return id;
+
+    // compress; content that will not shrink is stored
+    const std::string full = type + ' ' + std::to_string(content.size()) + '\0' + content;
+    std::string compressed;
+    if (!vit::storage::compressObject(full, vit::storage::levelFor(content), compressed)) {
+        std::cerr << "Compression failed\n";
+        known.forget(id);
+        return {};
     }
-    return bin;
-}
 
-std::string binaryToHexString(const std::string& bin)
-{
-    std::ostringstream ss;
-    for (unsigned char c : bin)
-        ss << std::hex << std::setw(2) << std::setfill('0')
-           << static_cast<int>(c);
-    return ss.str();
+    if (!vit::storage::storeLooseObject(id, compressed)) {
+        known.forget(id);
+        return {};
+    }
+    known.stored(id);
+    return id;
 }
 
-std::string getObjectPath(const std::string& hash)
+ObjectId writeBlob(const std::string& content) { return writeObject("blob",  content); }
+ObjectId writeBlobFile(const std::string& path) { return vit::storage::writeLooseBlobFromFile(path); }
+std::vector<ObjectId> writeBlobFiles(const std::vector<std::string>& paths)
 {
-    return ".git/objects/" + hash.substr(0, 2) + '/' + hash.substr(2);
+    return vit::storage::writeLooseBlobsFromFiles(paths);
 }
+ObjectId writeTree(const std::string& dirPath);
 
 
-
-std::string writeObject(const std::string& type, const std::string& content)
+std::string readObject(const ObjectId& id)
 {
-    const std::string header = type + ' ' + std::to_string(content.size()) + '\0';
-    const std::string full   = header + content;
-
-    unsigned char sha[SHA_DIGEST_LENGTH];
-    SHA1(reinterpret_cast<const unsigned char*>(full.data()), full.size(), sha);
-    const std::string hash = hashToHexString(sha);
+    vit::storage::ObjectType type;
+    const auto content = vit::storage::loadObjectShared(id, type);
+    if (!content) return {};
 
-    // compress
-    uLong dstSize = compressBound(full.size());
-    std::string compressed(dstSize, '\0');
-    if (compress(reinterpret_cast<Bytef*>(&compressed[0]), &dstSize,
-                 reinterpret_cast<const Bytef*>(full.data()), full.size()) != Z_OK) {
-        std::cerr << "Compression failed\n";
-        return {};
-    }
-    compressed.resize(dstSize);
-
-    // write to disk
-    const std::string dir  = ".git/objects/" + hash.substr(0, 2);
-    std::filesystem::create_directories(dir);
-    std::ofstream(getObjectPath(hash), std::ios::binary)
-        .write(compressed.data(), compressed.size());
-
-    return hash;
+    std::string out = std::string(vit::storage::typeName(type)) + ' ' +
+                      std::to_string(content->size()) + '\0';
+    out += *content;
+    return out;
 }
 
-std::string writeBlob(const std::string& content) { return writeObject("blob",  content); }
-std::string writeTree(const std::string& dirPath);
+std::string readObjectContent(const ObjectId& id)
+{
+    vit::storage::ObjectType type;
+    const auto content = vit::storage::loadObjectShared(id, type);
+    return content ? *content : std::string();
+}
 
 
-std::string readObject(const std::string& hash)
+/* ---------- parallel writeTree ---------- */
+namespace {
+
+// One directory of the tree being written. Its entries are filled in by
+// blob and subtree tasks; whichever of them finishes last builds the tree
+// object and reports up to the parent, so trees are written bottom-up
+// without any thread waiting on another. `cached` is the tree recorded for
+// this directory in the index; it is reused unless a file or subtree below
+// came out differently (`dirty`).
+struct TreeNode {
+    std::string                            path;
+    std::string                            relPath;   // from the root, for the index
+    TreeNode*                              parent = nullptr;
+    size_t                                 slot   = 0;   // index in parent->entries
+    std::vector<TreeEntry>                 entries;
+    std::vector<std::unique_ptr<TreeNode>> children;
+    std::atomic<size_t>                    pending{0};
+    ObjectId                               hash;
+
+    const vit::storage::CacheTree*         cached = nullptr;
+    std::atomic<bool>                      dirty{false};
+    int64_t                                fileCount = 0;   // recursive
+};
+
+std::string joinPath(const std::string& base, std::string_view name)
 {
-    std::ifstream in(getObjectPath(hash), std::ios::binary);
-    if (!in) {
-        std::cerr << "Object not found: " << hash << '\n';
-        return {};
+    std::string path;
+    path.reserve(base.size() + 1 + name.size());
+    if (!base.empty()) {
+        path = base;
+        path += '/';
     }
-    std::ostringstream ss; ss << in.rdbuf();
-    return decompressObject(ss.str());
+    path += name;
+    return path;
 }
 
-std::string readObjectContent(const std::string& hash)
+std::string baseName(const std::string& relPath)
 {
-    const std::string decompressed = readObject(hash);
-    const auto nullPos = decompressed.find('\0');
-    return nullPos == std::string::npos ? decompressed : decompressed.substr(nullPos + 1);
+    const size_t slash = relPath.rfind('/');
+    return slash == std::string::npos ? relPath : relPath.substr(slash + 1);
 }
 
-
-std::string writeTree(const std::string& dirPath)
+vit::storage::CacheTree buildCacheTree(const TreeNode& node)
 {
-    std::vector<TreeEntry> entries;
+    vit::storage::CacheTree tree;
+    tree.name       = baseName(node.relPath);
+    tree.entryCount = node.fileCount;
+    tree.id         = node.hash;
+    for (const auto& child : node.children) tree.children.push_back(buildCacheTree(*child));
+    std::sort(tree.children.begin(), tree.children.end(),
+              [](const vit::storage::CacheTree& a, const vit::storage::CacheTree& b){ return a.name < b.name; });
+    return tree;
+}
+
+class TreeWriter {
+public:
+    ObjectId run(const std::string& dirPath)
+    {
+        // the stat cache describes the work tree, so only a write of the
+        // whole work tree can use and refresh it
+        useIndex_ = dirPath == ".";
+        if (useIndex_) {
+            index_.load();
+            root_.cached = index_.cacheTree();
+        }
+
+        root_.path = dirPath;
+        pool_.submit([this] { scan(&root_); });
+        pool_.wait();
+        if (failed_) return {};
+
+        if (useIndex_) {
+            vit::storage::IndexFile updated;
+            for (auto& e : seen_) updated.add(std::move(e));
+            updated.setCacheTree(buildCacheTree(root_));
+            updated.write();
+        }
+        return root_.hash;
+    }
 
-    for (const auto& entry : std::filesystem::directory_iterator(dirPath)) {
-        const std::string name = entry.path().filename().string();
-        if (name == ".git") continue;
+private:
+    void scan(TreeNode* node)
+    {
+        for (const auto& entry : std::filesystem::directory_iterator(node->path)) {
+            const std::string name = entry.path().filename().string();
+            if (name == ".git") continue;
+
+            TreeEntry e;
+            e.filename = name;
+            if (entry.is_regular_file()) {
+                e.mode = "100644";
+            } else if (entry.is_directory()) {
+                e.mode = "40000";
+                auto child = std::make_unique<TreeNode>();
+                child->path    = entry.path().string();
+                child->relPath = joinPath(node->relPath, name);
+                child->parent  = node;
+                child->slot    = node->entries.size();
+                child->cached  = node->cached ? node->cached->child(name) : nullptr;
+                node->children.push_back(std::move(child));
+            } else {
+                failed_ = true;   // neither file nor directory: not representable
+                return;
+            }
+            node->entries.push_back(e);
+        }
 
-        TreeEntry e;
-        e.filename = name;
+        // every entry must be counted before the first task can finish
+        node->pending = node->entries.size();
+        if (node->entries.empty()) {
+            finish(node);
+            return;
+        }
+        // files go in batches, so that small blobs can be hashed together
+        constexpr size_t BATCH = 16;
+        std::vector<size_t> slots;
+        for (size_t i = 0; i < node->entries.size(); ++i) {
+            if (node->entries[i].mode != "100644") continue;
+            slots.push_back(i);
+            if (slots.size() < BATCH) continue;
+            pool_.submit([this, node, batch = std::move(slots)] { writeFiles(node, batch); });
+            slots.clear();
+        }
+        if (!slots.empty()) pool_.submit([this, node, batch = std::move(slots)] { writeFiles(node, batch); });
+        for (auto& child : node->children) {
+            TreeNode* c = child.get();
+            pool_.submit([this, c] { scan(c); });
+        }
+    }
 
-        if (entry.is_regular_file()) {
-            std::ifstream f(entry.path(), std::ios::binary);
-            std::ostringstream ss; ss << f.rdbuf();
-            e.hash = writeBlob(ss.str());
-            e.mode = "100644";
+    // Reuses the blob recorded in the index when a file's stat data still
+    // matches; the other files are read, hashed and stored together.
+    void writeFiles(TreeNode* node, const std::vector<size_t>& slots)
+    {
+        struct File {
+            size_t       slot;
+            std::string  rel;
+            struct stat  st{};
+            bool         statted = false;
+            const vit::storage::IndexEntry* cached = nullptr;
+            ObjectId     hash;
+        };
+        std::vector<File>        files;
+        std::vector<std::string> paths;    // of the files to store,
+        std::vector<size_t>      stored;   // and where they are in files
+        files.reserve(slots.size());
+        for (size_t slot : slots) {
+            const std::string& name = node->entries[slot].filename;
+            File& f = files.emplace_back();
+            f.slot  = slot;
+            const std::string path = node->path + '/' + name;
+            if (useIndex_) {
+                f.rel     = joinPath(node->relPath, name);
+                f.statted = ::stat(path.c_str(), &f.st) == 0;
+                f.cached  = f.statted ? index_.lookupClean(f.rel, f.st) : nullptr;
+                if (f.cached && vit::storage::KnownObjects::instance().contains(f.cached->id)) {
+                    f.hash = f.cached->id;
+                    continue;
+                }
+            }
+            paths.push_back(path);
+            stored.push_back(files.size() - 1);
         }
-        else if (entry.is_directory()) {
-            e.hash = writeTree(entry.path().string());
-            e.mode = "40000";
+        const std::vector<ObjectId> ids = writeBlobFiles(paths);
+        for (size_t i = 0; i < stored.size(); ++i) files[stored[i]].hash = ids[i];
+
+        // the last complete() may sort the entries, so names are not read
+        // past this point
+        for (const File& f : files) {
+            if (useIndex_) {
+                // a file the index does not know, or whose blob changed,
+                // invalidates every cached tree on its path
+                const auto* known = f.cached ? f.cached : index_.find(f.rel);
+                if (!known || f.hash.isNull() || known->id != f.hash)
+                    node->dirty.store(true, std::memory_order_relaxed);
+
+                if (f.statted && !f.hash.isNull()) {
+                    auto entry = vit::storage::IndexEntry::fromStat(f.rel, f.st, f.hash);
+                    std::lock_guard<std::mutex> lock(seenMutex_);
+                    seen_.push_back(std::move(entry));
+                }
+            }
+            complete(node, f.slot, f.hash);
         }
-        if (e.hash.empty()) return {};
-        entries.push_back(e);
     }
 
-    std::sort(entries.begin(), entries.end(),
-              [](const TreeEntry& a, const TreeEntry& b){ return a.filename < b.filename; });
+    void complete(TreeNode* node, size_t slot, const ObjectId& hash)
+    {
+        if (hash.isNull()) failed_ = true;
+        node->entries[slot].hash = hash;
+        if (node->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) finish(node);
+    }
+
+    void finish(TreeNode* node)
+    {
+        if (failed_) return;
+
+        node->fileCount = static_cast<int64_t>(node->entries.size() - node->children.size());
+        for (const auto& child : node->children) node->fileCount += child->fileCount;
+
+        // the index holds exactly the files seen when the cached tree was
+        // written, so the same files with the same blobs and the same
+        // subtrees give the same tree
+        const auto* cached = node->cached;
+        if (cached && !node->dirty.load(std::memory_order_relaxed) &&
+            cached->entryCount == node->fileCount &&
+            cached->children.size() == node->children.size() &&
+            vit::storage::KnownObjects::instance().contains(cached->id)) {
+            node->hash = cached->id;
+        } else {
+            auto& entries = node->entries;
+            std::sort(entries.begin(), entries.end(),
+                      [](const TreeEntry& a, const TreeEntry& b){ return a.filename < b.filename; });
+
+            std::string treeContent;
+            for (const auto& e : entries) {
+                treeContent += e.mode + ' ' + e.filename + '\0';
+                treeContent += e.hash.raw();
+            }
+            node->hash = writeObject("tree", treeContent);
+        }
 
-    std::string treeContent;
-    for (const auto& e : entries) {
-        treeContent += e.mode + ' ' + e.filename + '\0';
-        treeContent += hexStringToBinary(e.hash);
+        if (node->parent) {
+            if (!cached || node->hash.isNull() || cached->id != node->hash)
+                node->parent->dirty.store(true, std::memory_order_relaxed);
+            complete(node->parent, node->slot, node->hash);
+        }
+        else if (node->hash.isNull()) failed_ = true;
     }
-    return writeObject("tree", treeContent);
+
+    vit::utils::ThreadPool                pool_;
+    TreeNode                              root_;
+    std::atomic<bool>                     failed_{false};
+
+    bool                                  useIndex_ = false;
+    vit::storage::IndexFile               index_;      // read-only while tasks run
+    std::mutex                            seenMutex_;
+    std::vector<vit::storage::IndexEntry> seen_;       // the refreshed index
+};
+
 }
 
-std::vector<FileInfo> parseTree(const std::string& treeHash)
+// Blobs are hashed and compressed on a work-stealing pool (config
+// `threads`); the resulting tree is identical to a sequential walk. For the
+// work tree root, files whose stat data matches .git/index are not read, and
+// directories with nothing changed below them reuse the tree cached there.
+ObjectId writeTree(const std::string& dirPath)
+{
+    return TreeWriter().run(dirPath);
+}
+
+std::vector<FileInfo> parseTree(const ObjectId& treeHash)
 {
     std::vector<FileInfo> files;
-    const std::string content = readObjectContent(treeHash);
-    if (content.empty()) return files;
-
-    size_t pos = 0;
-    while (pos < content.size()) {
-        const size_t nullPos = content.find('\0', pos);
-        if (nullPos == std::string::npos) break;
-
-        const std::string header = content.substr(pos, nullPos - pos);
-        const size_t spPos = header.find_last_of(' ');
-        if (spPos != std::string::npos) {
-            FileInfo f;
-            f.mode = header.substr(0, spPos);
-            f.name = header.substr(spPos + 1);
-            const std::string binHash = content.substr(nullPos + 1, 20);
-            f.hash = binaryToHexString(binHash);
-            f.isDirectory = f.mode.substr(0,3) == "400";
-            files.push_back(f);
-        }
-        pos = nullPos + 1 + 20;   // skip hash
-    }
+    for (const auto& e : vit::storage::TreeView(treeHash))
+        files.push_back(FileInfo{std::string(e.name), e.id, std::string(e.modeText), e.isDirectory()});
     return files;
 }
 
-bool restoreTree(const std::string& treeHash, const std::string& base)
+bool restoreTree(const ObjectId& treeHash, const std::string& base)
 {
-    for (const auto& f : parseTree(treeHash)) {
-        const std::string path = base.empty() ? f.name : base + '/' + f.name;
-        if (f.isDirectory) {
-            std::filesystem::create_directories(path);
-            if (!restoreTree(f.hash, path)) return false;
-        } else {
-            const std::string blob = readObjectContent(f.hash);
-            if (blob.empty()) return false;
-
-            auto parentPath = std::filesystem::path(path).parent_path();
-            if (!parentPath.empty()) {
-                std::filesystem::create_directories(parentPath);
-            }
-            std::ofstream out(path, std::ios::binary);
-            if (!out) return false;
-            out << blob;
-        }
-    }
-    return true;
+    return restoreTreeOverwrite(treeHash, base);
 }
 
-void collectTreeFiles(const std::string& treeHash,
+void collectTreeFiles(const ObjectId& treeHash,
                       const std::string& base,
                       std::set<std::string>& out)
 {
-    for (const auto& f : parseTree(treeHash)) {
-        const std::string path = base.empty() ? f.name : base + '/' + f.name;
-        if (f.isDirectory)
-            collectTreeFiles(f.hash, path, out);
+    for (const auto& f : vit::storage::TreeView(treeHash)) {
+        std::string path = joinPath(base, f.name);
+        if (f.isDirectory())
+            collectTreeFiles(f.id, path, out);
         else
-            out.insert(path);
+            out.insert(std::move(path));
     }
 }
 
-bool restoreTreeOverwrite(const std::string& treeHash, const std::string& base)
+namespace {
+
+struct CheckoutFile {
+    std::string path;
+    ObjectId    id;
+};
+
+// Every directory (parents before their children) and file under a tree,
+// in tree order.
+void planCheckout(const ObjectId& treeHash, const std::string& base,
+                  std::vector<std::string>& dirs, std::vector<CheckoutFile>& files)
 {
-    for (const auto& f : parseTree(treeHash)) {
-        const std::string path = base.empty() ? f.name : base + '/' + f.name;
-        if (f.isDirectory) {
-            std::filesystem::create_directories(path);
-            if (!restoreTreeOverwrite(f.hash, path)) return false;
+    for (const auto& f : vit::storage::TreeView(treeHash)) {
+        std::string path = joinPath(base, f.name);
+        if (f.isDirectory()) {
+            dirs.push_back(path);
+            planCheckout(f.id, path, dirs, files);
         } else {
-            const std::string blob = readObjectContent(f.hash);
-            if (blob.empty()) return false;
+            files.push_back({std::move(path), f.id});
+        }
+    }
+}
 
-            auto parentPath = std::filesystem::path(path).parent_path();
-            if (!parentPath.empty()) {
-                std::filesystem::create_directories(parentPath);
+// Inflates and writes `files` on the worker pool (config `threads`), in
+// batches; their directories must exist. Once every write is done, index
+// entries are added in the order of `files` and failures are reported
+// sorted by path, so the output does not depend on scheduling.
+bool writeCheckoutFiles(const std::vector<CheckoutFile>& files, vit::storage::IndexFile* index)
+{
+    constexpr size_t BATCH = 64;
+
+    struct Outcome {
+        bool        written = false;
+        bool        statted = false;
+        struct stat st{};
+        std::string error;
+    };
+    std::vector<Outcome> outcomes(files.size());
+
+    vit::utils::ThreadPool pool;
+    for (size_t begin = 0; begin < files.size(); begin += BATCH) {
+        pool.submit([&, begin] {
+            const size_t end = std::min(begin + BATCH, files.size());
+            for (size_t i = begin; i < end; ++i) {
+                Outcome& out = outcomes[i];
+                out.written = vit::storage::writeObjectToFile(files[i].id, files[i].path, &out.error);
+                // record what was just written, so the next commit need not read it
+                if (out.written && index) out.statted = ::stat(files[i].path.c_str(), &out.st) == 0;
             }
-            std::ofstream out(path, std::ios::binary);
-            if (!out) return false;
-            out << blob;
-        }
+        });
     }
-    return true;
+    pool.wait();
+
+    std::vector<size_t> failed;
+    for (size_t i = 0; i < files.size(); ++i) {
+        const Outcome& out = outcomes[i];
+        if (!out.written)
+            failed.push_back(i);
+        else if (out.statted)
+            index->add(vit::storage::IndexEntry::fromStat(files[i].path, out.st, files[i].id));
+    }
+    std::sort(failed.begin(), failed.end(),
+              [&](size_t a, size_t b) { return files[a].path < files[b].path; });
+    for (size_t i : failed) std::cerr << outcomes[i].error << '\n';
+    return failed.empty();
+}
+
+// Whether replacing the work tree file at `path` (`before` in HEAD, null if
+// untracked) with `after` would lose changes: true unless the file is
+// missing or holds one of the two versions. A directory in the way only
+// counts if something in it is not among the `removed` files.
+bool wouldClobber(const std::string& path, const ObjectId& before, const ObjectId& after,
+                  const vit::storage::IndexFile& index, const std::unordered_set<std::string>& removed)
+{
+    struct stat st{};
+    if (::lstat(path.c_str(), &st) != 0) return false;
+    if (S_ISDIR(st.st_mode)) {
+        for (const auto& e : std::filesystem::recursive_directory_iterator(path))
+            if (!e.is_directory() && !removed.count(e.path().string())) return true;
+        return false;
+    }
+    if (!S_ISREG(st.st_mode)) return true;
+
+    const auto*    cached  = index.lookupClean(path, st);
+    const ObjectId current = cached ? cached->id : vit::storage::hashBlobFromFile(path);
+    return current.isNull() || (current != before && current != after);
+}
+
+// Removes the directories above `path` that are left empty, deepest first.
+void removeEmptyParents(const std::string& path)
+{
+    std::error_code ec;
+    for (auto dir = std::filesystem::path(path).parent_path(); !dir.empty(); dir = dir.parent_path())
+        if (!std::filesystem::remove(dir, ec)) break;
+}
+
+}
+
+// Directories are made up front in one pass, then every blob is written
+// through writeCheckoutFiles.
+bool restoreTreeOverwrite(const ObjectId& treeHash, const std::string& base,
+                          vit::storage::IndexFile* index)
+{
+    std::vector<std::string>  dirs;
+    std::vector<CheckoutFile> files;
+    planCheckout(treeHash, base, dirs, files);
+
+    if (!base.empty()) std::filesystem::create_directories(base);
+    for (const auto& dir : dirs) std::filesystem::create_directory(dir);
+
+    return writeCheckoutFiles(files, index);
 }
 
 
 
-std::string writeCommit(const std::string& tree,
-                        const std::string& parent,
-                        const std::string& message,
-                        const std::string& author,
-                        const std::string& email)
+ObjectId writeCommit(const ObjectId& tree,
+                     const ObjectId& parent,
+                     const std::string& message,
+                     const std::string& author,
+                     const std::string& email)
 {
     std::string c =
-        "tree "      + tree   + '\n' +
-        (parent.empty() ? "" : "parent " + parent + '\n') +
+        "tree "      + tree.hex() + '\n' +
+        (parent.isNull() ? "" : "parent " + parent.hex() + '\n') +
         "author "    + author + " <" + email + "> " + std::to_string(std::time(nullptr)) + '\n' +
         "committer " + author + " <" + email + "> " + std::to_string(std::time(nullptr)) + "\n\n" +
         message + '\n';
-    return writeObject("commit", c);
+    const ObjectId id = writeObject("commit", c);
+    if (!id.isNull()) vit::storage::updateCommitGraph(id);
+    return id;
 }
 
-std::string readHead()
+ObjectId readHead()
 {
     std::ifstream in(".git/HEAD");
     if (!in) return {};
@@ -284,12 +527,12 @@ std::string readHead()
     if (line.rfind("ref: ", 0) == 0) {
         std::ifstream ref(".git/" + line.substr(5));
         std::string   hash; std::getline(ref, hash);
-        return hash;
+        return ObjectId::fromHex(hash);
     }
-    return line; // detached
+    return ObjectId::fromHex(line); // detached
 }
 
-bool writeHead(const std::string& hash)
+bool writeHead(const ObjectId& hash)
 {
     std::ofstream(".git/HEAD") << hash << '\n';
     return true;
@@ -297,33 +540,18 @@ bool writeHead(const std::string& hash)
 
 
 
-CommitInfo parseCommit(const std::string& commitHash)
+CommitInfo parseCommit(const ObjectId& commitHash)
 {
     CommitInfo info;
-    std::string content = readObjectContent(commitHash);
-    if (content.empty()) return info;
-
-    info.hash = commitHash;
-    std::istringstream in(content);
-    std::string line;
-    while (std::getline(in, line)) {
-        if      (line.rfind("tree ",   0) == 0) info.treeHash   = line.substr(5);
-        else if (line.rfind("parent ", 0) == 0) info.parentHash = line.substr(7);
-        else if (line.rfind("author ", 0) == 0) {
-            size_t lt = line.find('<'), gt = line.find('>');
-            if (lt != std::string::npos && gt != std::string::npos)
-                info.author = line.substr(7, lt - 8);
-            if (gt + 2 < line.size()) info.timestamp = line.substr(gt + 2);
-        }
-        else if (line.empty()) {// message starts
-            std::ostringstream msg;
-            while (std::getline(in, line)) { msg << line << '\n'; }
-            info.message = msg.str();
-            if (!info.message.empty() && info.message.back() == '\n')
-                info.message.pop_back();
-            break;
-        }
-    }
+    const vit::storage::CommitView view(commitHash);
+    if (!view.valid()) return info;
+
+    info.hash       = commitHash;
+    info.treeHash   = view.tree();
+    info.parentHash = view.parent(0);
+    info.author     = view.authorName();
+    info.timestamp  = view.authorTime();
+    info.message    = view.message();
     return info;
 }
 
@@ -339,6 +567,30 @@ std::string formatTimestamp(const std::string& ts)
 }
 
 
+bool parseTimestamp(const std::string& text, int64_t& seconds)
+{
+    if (!text.empty() && std::all_of(text.begin(), text.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        try { seconds = std::stoll(text); } catch (...) { return false; }
+        return true;
+    }
+
+    std::tm tm{};
+    int  consumed = 0;
+    if (std::sscanf(text.c_str(), "%d-%d-%d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &consumed) != 3)
+        return false;
+    if (text[consumed] != '\0' &&
+        std::sscanf(text.c_str() + consumed, " %d:%d:%d", &tm.tm_hour, &tm.tm_min, &tm.tm_sec) < 2)
+        return false;
+    tm.tm_year -= 1900;
+    tm.tm_mon  -= 1;
+    tm.tm_isdst = -1;
+    const time_t t = std::mktime(&tm);
+    if (t == time_t(-1)) return false;
+    seconds = t;
+    return true;
+}
+
+
 std::set<std::string> getWorkingDirectoryFiles(const std::string& path)
 {
     std::set<std::string> out;
@@ -353,83 +605,257 @@ std::set<std::string> getWorkingDirectoryFiles(const std::string& path)
 }
 
 
-bool safeCheckout(const std::string& commitHash)
+// Only the paths that differ between HEAD's tree and the target are
+// touched: subtrees with equal ids are never read, files outside the diff
+// are left alone (untracked ones included) and keep their index entries.
+bool safeCheckout(const ObjectId& commitHash)
 {
     const CommitInfo ci = parseCommit(commitHash);
-    if (ci.hash.empty()) {
+    if (ci.hash.isNull()) {
         std::cerr << "Invalid commit: " << commitHash << '\n';
         return false;
     }
 
-    std::cout << "Checking out " << commitHash << " – " << ci.message << '\n';
-
-    if (!restoreTreeOverwrite(ci.treeHash)) return false;
+    const ObjectId head     = readHead();
+    const ObjectId headTree = head.isNull() ? ObjectId() : parseCommit(head).treeHash;
+
+    struct Change {
+        std::string path;
+        ObjectId    before;   // null when added
+        ObjectId    after;    // null when removed
+    };
+    std::vector<Change> changes;
+    vit::storage::diffTrees(headTree, ci.treeHash,
+        [&](const std::string& path, const vit::storage::TreeViewEntry* before,
+            const vit::storage::TreeViewEntry* after) {
+            changes.push_back({path, before ? before->id : ObjectId(), after ? after->id : ObjectId()});
+            return true;
+        });
+
+    vit::storage::IndexFile index;
+    index.load();
+
+    std::unordered_set<std::string> removed;
+    for (const auto& c : changes)
+        if (c.after.isNull()) removed.insert(c.path);
+
+    std::vector<std::string> conflicts;
+    for (const auto& c : changes)
+        if (wouldClobber(c.path, c.before, c.after, index, removed)) conflicts.push_back(c.path);
+    if (!conflicts.empty()) {
+        std::cerr << "Your local changes to the following files would be overwritten by checkout:\n";
+        for (const auto& path : conflicts) std::cerr << "    " << path << '\n';
+        std::cerr << "Commit them or remove them before switching. Aborting\n";
+        return false;
+    }
 
-    // clean untracked
-    std::set<std::string> expected;
-    collectTreeFiles(ci.treeHash, "", expected);
+    std::cout << "Checking out " << commitHash << " – " << ci.message << '\n';
 
-    for (const auto& f : getWorkingDirectoryFiles()) {
-        if (!expected.count(f)) {
-            std::filesystem::remove(f);
-            std::cout << "Removed " << f << '\n';
+    // removals go first, as a removed file may make way for a directory
+    std::vector<CheckoutFile> writes;
+    std::set<std::string>     dirs;
+    for (const auto& c : changes) {
+        index.invalidatePath(c.path);
+        if (c.after.isNull()) {
+            std::error_code ec;
+            std::filesystem::remove(c.path, ec);
+            removeEmptyParents(c.path);
+            index.remove(c.path);
+            std::cout << "Removed " << c.path << '\n';
+        } else {
+            const std::string dir = std::filesystem::path(c.path).parent_path().string();
+            if (!dir.empty()) dirs.insert(dir);
+            writes.push_back({c.path, c.after});
         }
     }
+    for (const auto& dir : dirs) std::filesystem::create_directories(dir);
+    if (!writeCheckoutFiles(writes, &index)) return false;
 
+    index.write();
     writeHead(commitHash);
     std::cout << "Checkout complete\n";
     return true;
 }
 
 
-std::vector<std::string> findAllCommitHashes()
+std::vector<ObjectId> findAllCommitHashes()
 {
-    std::vector<std::string> out;
-    std::unordered_set<std::string> seen;
-
-    for (const auto& dir : std::filesystem::directory_iterator(".git/objects")) {
-        if (!dir.is_directory() || dir.path().filename().string().size() != 2) continue;
-        for (const auto& file : std::filesystem::directory_iterator(dir.path())) {
-            const std::string hash = dir.path().filename().string() + file.path().filename().string();
-            if (hash.size() != 40) continue;
-            const std::string obj = readObject(hash);
-            if (!obj.empty() && obj.rfind("commit ", 0) == 0 && !seen.count(hash)) {
-                out.push_back(hash); seen.insert(hash);
-            }
+    std::vector<ObjectId> out;
+    std::unordered_set<ObjectId> seen;
+
+    std::vector<ObjectId> candidates = vit::storage::listLooseObjects();
+    const auto packed = vit::storage::PackStore::instance().objectHashes();
+    candidates.insert(candidates.end(), packed.begin(), packed.end());
+
+    vit::storage::ObjectType type;
+    uint64_t size;
+    for (const auto& hash : candidates) {
+        if (!seen.count(hash) && vit::storage::peekObjectHeader(hash, type, size) &&
+            type == vit::storage::ObjectType::Commit) {
+            out.push_back(hash); seen.insert(hash);
         }
     }
     return out;
 }
 
-std::vector<std::string> getReachableCommits(const std::vector<std::string>& start)
+std::vector<ObjectId> getReachableCommits(const std::vector<ObjectId>& start)
 {
-    std::vector<std::string> order;
-    std::unordered_set<std::string> vis;
-    std::queue<std::string> q; // queue for BFS
+    const auto& graph = vit::storage::CommitGraph::instance();
+
+    std::vector<ObjectId> order;
+    std::unordered_set<ObjectId> vis;
+    std::queue<ObjectId> q; // queue for BFS
 
-    for (const auto& h : start) if (!h.empty() && vis.insert(h).second) q.push(h);
+    for (const auto& h : start) if (!h.isNull() && vis.insert(h).second) q.push(h);
 
+    std::vector<uint32_t> parents;
     while (!q.empty()) {
-        const std::string cur = q.front(); q.pop();
+        const ObjectId cur = q.front(); q.pop();
         order.push_back(cur);
-        const auto parent = parseCommit(cur).parentHash;
-        if (!parent.empty() && vis.insert(parent).second)
-            q.push(parent);
+
+        // parents come from the commit-graph when it has the commit
+        uint32_t pos;
+        parents.clear();
+        if (graph.lookup(cur, pos) && graph.parentsAt(pos, parents)) {
+            for (uint32_t p : parents) {
+                const ObjectId parent = graph.idAt(p);
+                if (vis.insert(parent).second) q.push(parent);
+            }
+            continue;
+        }
+        const vit::storage::CommitView commit(cur);
+        for (size_t i = 0; i < commit.parentCount(); ++i) {
+            const ObjectId parent = commit.parent(i);
+            if (!parent.isNull() && vis.insert(parent).second) q.push(parent);
+        }
     }
     return order;
 }
 
-std::vector<std::string> collectReferenceCommits()
+namespace {
+
+// Tree of `commit` and of its first parent (null for a root commit),
+// from the commit-graph when it has them.
+void commitTrees(const ObjectId& commit, ObjectId& tree, ObjectId& parentTree)
+{
+    const auto& graph = vit::storage::CommitGraph::instance();
+    uint32_t pos;
+    std::vector<uint32_t> parents;
+    if (graph.lookup(commit, pos) && graph.parentsAt(pos, parents)) {
+        tree       = graph.treeAt(pos);
+        parentTree = parents.empty() ? ObjectId() : graph.treeAt(parents[0]);
+        return;
+    }
+
+    const vit::storage::CommitView view(commit);
+    tree = view.tree();
+    const ObjectId parent = view.parent(0);
+    parentTree = parent.isNull() ? ObjectId() : vit::storage::CommitView(parent).tree();
+}
+
+}
+
+PathFilter::PathFilter(std::string_view path)
+{
+    if (path.starts_with("./")) path.remove_prefix(2);
+    while (!path.empty() && path.back() == '/') path.remove_suffix(1);
+    if (path == ".") path = {};
+
+    path_ = path;
+    keys_ = vit::storage::bloomKeysForPath(path_);
+}
+
+bool PathFilter::matches(const ObjectId& commit) const
+{
+    if (path_.empty()) return true;
+
+    // a filter can rule the commit out without reading any tree
+    const auto& graph = vit::storage::CommitGraph::instance();
+    uint32_t pos;
+    if (graph.lookup(commit, pos)) {
+        const std::string_view filter = graph.bloomFilterAt(pos);
+        const bool maybe = std::all_of(keys_.begin(), keys_.end(), [&](const auto& key) {
+            return vit::storage::bloomMaybeContains(filter, key);
+        });
+        if (!maybe) return false;
+    }
+
+    ObjectId tree, parentTree;
+    commitTrees(commit, tree, parentTree);
+    return vit::storage::pathChanged(parentTree, tree, path_);
+}
+
+vit::utils::Generator<vit::storage::CommitView>
+walkCommitsByDate(std::vector<ObjectId> start, CommitWalkOptions options)
+{
+    const auto& graph = vit::storage::CommitGraph::instance();
+    constexpr uint32_t NOT_IN_GRAPH = UINT32_MAX;
+
+    struct Pending {
+        int64_t                  time;
+        uint64_t                 order;   // ties come out first in, first out
+        ObjectId                 id;
+        uint32_t                 pos;     // in the commit-graph
+        vit::storage::CommitView view;    // read already when not in the graph
+
+        bool operator<(const Pending& o) const
+        {
+            return time != o.time ? time < o.time : order > o.order;
+        }
+    };
+
+    const PathFilter filter(options.path);
+
+    std::priority_queue<Pending> queue;
+    std::unordered_set<ObjectId> seen;
+    uint64_t                     reached = 0;
+
+    auto push = [&](const ObjectId& id) {
+        if (id.isNull() || !seen.insert(id).second) return;
+        uint32_t pos;
+        if (graph.lookup(id, pos)) {
+            queue.push({int64_t(graph.commitTimeAt(pos)), reached++, id, pos, {}});
+            return;
+        }
+        vit::storage::CommitView view(id);
+        if (!view.valid()) return;
+        const int64_t time = int64_t(view.committerTime());
+        queue.push({time, reached++, id, NOT_IN_GRAPH, std::move(view)});
+    };
+
+    for (const auto& id : start) push(id);
+
+    std::vector<uint32_t> parents;
+    while (!queue.empty()) {
+        Pending next = queue.top();
+        queue.pop();
+        if (next.time < options.since) break;
+
+        parents.clear();
+        if (next.pos != NOT_IN_GRAPH && graph.parentsAt(next.pos, parents)) {
+            for (uint32_t p : parents) push(graph.idAt(p));
+        } else {
+            if (!next.view.valid()) next.view = vit::storage::CommitView(next.id);
+            for (size_t i = 0; i < next.view.parentCount(); ++i) push(next.view.parent(i));
+        }
+
+        if (next.time > options.until || !filter.matches(next.id)) continue;
+        if (!next.view.valid()) next.view = vit::storage::CommitView(next.id);
+        if (next.view.valid()) co_yield next.view;
+    }
+}
+
+std::vector<ObjectId> collectReferenceCommits()
 {
-    std::vector<std::string> refs;
-    if (const std::string h = readHead(); !h.empty()) refs.push_back(h);
+    std::vector<ObjectId> refs;
+    if (const ObjectId h = readHead(); !h.isNull()) refs.push_back(h);
 
     const std::string refsDir = ".git/refs/heads";
     if (std::filesystem::exists(refsDir)) {
         for (const auto& e : std::filesystem::directory_iterator(refsDir)) {
             std::ifstream rf(e.path());
             std::string   hash; std::getline(rf, hash);
-            if (!hash.empty()) refs.push_back(hash);
+            if (const ObjectId id = ObjectId::fromHex(hash); !id.isNull()) refs.push_back(id);
         }
     }
     return refs;
@@ -1,43 +1,57 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <set>
 #include <unordered_set>
 
+#include "storage/bloom_filter.hpp"
+#include "storage/commit_view.hpp"
+#include "storage/object_id.hpp"
+#include "utils/generator.hpp"
+
+namespace vit::storage { class IndexFile; }
+
+// Object names are passed as raw 20-byte ids; the null id means "none" or
+// "failed". Hex only appears at the edges: paths, refs and output.
+using vit::storage::ObjectId;
+
 /* ---------- Low-level object helpers ---------- */
-std::string hashToHexString(const unsigned char* hash);
-std::string hexStringToBinary(const std::string& hexString);
 std::string binaryToHexString(const std::string& binary);
-std::string getObjectPath(const std::string& hash);
+std::string getObjectPath(const ObjectId& id);
 
-std::string writeObject(const std::string& type, const std::string& content);
-std::string writeBlob(const std::string& content);
-std::string writeTree(const std::string& directoryPath);
+ObjectId writeObject(const std::string& type, const std::string& content);
+ObjectId writeObject(const std::string& type, const std::string& content, const ObjectId& id);   // id already hashed
+ObjectId writeBlob(const std::string& content);
+ObjectId writeBlobFile(const std::string& path);   // streams, for files of any size
+std::vector<ObjectId> writeBlobFiles(const std::vector<std::string>& paths);   // small ones hashed together
+ObjectId writeTree(const std::string& directoryPath);
 
-std::string readObject(const std::string& hash);
-std::string readObjectContent(const std::string& hash);
+std::string readObject(const ObjectId& id);
+std::string readObjectContent(const ObjectId& id);
 
 /* ---------- commit / branch primitives ---------- */
-std::string writeCommit(const std::string& treeHash,
-                        const std::string& parentHash,
-                        const std::string& message,
-                        const std::string& author,
-                        const std::string& email);
+ObjectId writeCommit(const ObjectId& treeHash,
+                     const ObjectId& parentHash,   // null for a root commit
+                     const std::string& message,
+                     const std::string& author,
+                     const std::string& email);
 
-std::string readHead();
-bool        writeHead(const std::string& commitHash);
+ObjectId readHead();   // null before the first commit
+bool     writeHead(const ObjectId& commitHash);
 
 /* ---------- data structures ---------- */
 struct TreeEntry {
     std::string mode;
-    std::string hash;
+    ObjectId    hash;
     std::string filename;
 };
 
 struct CommitInfo {
-    std::string hash;
-    std::string treeHash;
-    std::string parentHash;
+    ObjectId    hash;   // null if the commit could not be read
+    ObjectId    treeHash;
+    ObjectId    parentHash;
     std::string author;
     std::string message;
     std::string timestamp;
@@ -45,33 +59,68 @@ struct CommitInfo {
 
 struct FileInfo {
     std::string name;
-    std::string hash;
+    ObjectId    hash;
     std::string mode;
     bool        isDirectory;
 };
 
 /* ---------- higher-level helpers ---------- */
-CommitInfo              parseCommit(const std::string& commitHash);
+CommitInfo              parseCommit(const ObjectId& commitHash);
 std::string             formatTimestamp(const std::string& ts);
+// Seconds since the epoch, or "YYYY-MM-DD[ HH:MM[:SS]]" in local time.
+bool                    parseTimestamp(const std::string& text, int64_t& seconds);
 
-std::vector<FileInfo>   parseTree(const std::string& treeHash);
-bool                    restoreTree(const std::string& treeHash,
+// Owning copies of a tree's entries; storage/tree_view.hpp walks them in place.
+std::vector<FileInfo>   parseTree(const ObjectId& treeHash);
+bool                    restoreTree(const ObjectId& treeHash,
                                     const std::string& basePath = "");
-void                    collectTreeFiles(const std::string& treeHash,
+void                    collectTreeFiles(const ObjectId& treeHash,
                                          const std::string& basePath,
                                          std::set<std::string>& fileSet);
-bool                    restoreTreeOverwrite(const std::string& treeHash,
-                                             const std::string& basePath = "");
+bool                    restoreTreeOverwrite(const ObjectId& treeHash,
+                                             const std::string& basePath = "",
+                                             vit::storage::IndexFile* index = nullptr);
 
 std::set<std::string>   getWorkingDirectoryFiles(const std::string& path = ".");
-bool                    safeCheckout(const std::string& commitHash);
+bool                    safeCheckout(const ObjectId& commitHash);
 
 /* ---------- reachability / refs ---------- */
-std::vector<std::string> findAllCommitHashes();
-std::vector<std::string> getReachableCommits(const std::vector<std::string>& start);
-std::vector<std::string> collectReferenceCommits();
+std::vector<ObjectId> findAllCommitHashes();
+std::vector<ObjectId> getReachableCommits(const std::vector<ObjectId>& start);
+std::vector<ObjectId> collectReferenceCommits();
+
+struct CommitWalkOptions {
+    int64_t     since = INT64_MIN;   // stop once the walk reaches older commits
+    int64_t     until = INT64_MAX;   // skip newer commits but walk through them
+    std::string path;                // only commits changing it (see PathFilter)
+};
+
+// Lazily yields the commits reachable from `start`, newest committer time
+// first (ties in the order they were reached), each exactly once. Only
+// the frontier is held in memory and nothing past the last commit the
+// caller pulls is read, so stopping early is cheap. Times and parents
+// come from the commit-graph where it has them; a commit's object is
+// inflated once, for the view handed out; commits skipped by `until` or
+// `path` are never inflated when the graph has them. Like git, `since`
+// assumes parents are not newer than their children.
+vit::utils::Generator<vit::storage::CommitView>
+walkCommitsByDate(std::vector<ObjectId> start, CommitWalkOptions options = {});
+
+// Tests whether commits change `path` (a file or a directory) relative to
+// their first parent. Changed-path Bloom filters from the commit-graph
+// rule most commits out without reading trees.
+class PathFilter {
+public:
+    explicit PathFilter(std::string_view path);
+
+    bool matches(const ObjectId& commit) const;
+
+private:
+    std::string                         path_;   // empty matches every commit
+    std::vector<vit::storage::BloomKey> keys_;
+};
 
 std::string getCurrentBranch();
 bool        updateBranch(const std::string& branchName,
-                         const std::string& commitHash);
+                         const ObjectId& commitHash);
 bool        switchToBranch(const std::string& branchName);
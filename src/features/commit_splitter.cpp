@@ -12,7 +12,7 @@ namespace vit::features {
 CommitSplitter::CommitSplitter(std::shared_ptr<vit::ai::AIClient> aiClient, std::string userName, std::string userEmail) 
     : aiClient_(aiClient), changeAnalyzer_(aiClient), userName(userName), userEmail(userEmail) {}
 
-CommitSplitter::SplitResult CommitSplitter::analyzeAndSuggestSplits(const std::string& commitHash, 
+CommitSplitter::SplitResult CommitSplitter::analyzeAndSuggestSplits(const ObjectId& commitHash, 
                                                                    const std::string& fallbackMessage) {
     try {
         auto analysisResult = changeAnalyzer_.analyzeChanges(commitHash, true);  // Source files only
@@ -213,19 +213,19 @@ bool CommitSplitter::executeSplits(const SplitResult& splits, bool dryRun) {
 
 bool CommitSplitter::createCommitFromGroup(const CommitGroup& group) {
     try {
-        std::string treeHash = writeTree(".");
-        if (treeHash.empty()) {
+        const ObjectId treeHash = writeTree(".");
+        if (treeHash.isNull()) {
             std::cerr << "Failed to create tree for commit group" << std::endl;
             return false;
         }
         
-        std::string parentHash = readHead();
+        const ObjectId parentHash = readHead();
         
         std::string author = userName;
         std::string email = userEmail;
         
-        std::string commitHash = writeCommit(treeHash, parentHash, group.commitMessage, author, email);
-        if (commitHash.empty()) {
+        const ObjectId commitHash = writeCommit(treeHash, parentHash, group.commitMessage, author, email);
+        if (commitHash.isNull()) {
             std::cerr << "Failed to create commit object" << std::endl;
             return false;
         }
@@ -244,7 +244,7 @@ bool CommitSplitter::createCommitFromGroup(const CommitGroup& group) {
             }
         }
         
-        std::cout << "  ✓ " << commitHash.substr(0, 8) << " " << group.commitMessage << std::endl;
+        std::cout << "  ✓ " << commitHash.hex().substr(0, 8) << " " << group.commitMessage << std::endl;
         return true;
         
     } catch (const std::exception& e) {
@@ -41,10 +41,10 @@ public:
     
     /**
      * Analyze changes and suggest commit splits
-     * @param commitHash Commit to compare against (empty = HEAD)
+     * @param commitHash Commit to compare against (null = HEAD)
      * @param fallbackMessage Message to use if no split is suggested
      */
-    SplitResult analyzeAndSuggestSplits(const std::string& commitHash = "", 
+    SplitResult analyzeAndSuggestSplits(const ObjectId& commitHash = {}, 
                                        const std::string& fallbackMessage = "Update multiple files");
 
     /**
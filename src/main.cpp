@@ -5,21 +5,41 @@
 #include <zlib.h>
 #include <iomanip>
 #include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string_view>
 #include <openssl/sha.h>
+#include <cstdlib>
+#include <ctime>
 
 #include "commit.hpp"
 #include "branch.hpp"
 #include "features/comment_generator.hpp"
 #include "ai/ai_client.hpp"
 #include "utils/file_utils.hpp"
+#include "utils/thread_pool.hpp"
 #include "features/interactive_review.hpp"
 #include "features/review_generator.hpp"
 #include "features/commit_splitter.hpp"
+#include "storage/bitmap_index.hpp"
+#include "storage/commit_graph.hpp"
+#include "storage/commit_view.hpp"
+#include "storage/compression.hpp"
+#include "storage/gc.hpp"
+#include "storage/pack.hpp"
+#include "storage/known_objects.hpp"
+#include "storage/object_cache.hpp"
+#include "storage/object_store.hpp"
+#include "storage/sha1.hpp"
+#include "storage/tree_view.hpp"
+#include "storage/zstd_codec.hpp"
 
 struct VitConfig {
     bool localAI = true;
     std::string userName;
     std::string userEmail;
+    size_t threads = 0;   // worker threads, 0 = one per core
+    int compression = -1;   // zlib level 0-9, -1 = zlib's default
 };
 
 VitConfig config;
@@ -29,18 +49,50 @@ void persistConfig() {
     configFile << config.localAI << '\n';
     configFile << config.userName << '\n';
     configFile << config.userEmail << '\n';
+    configFile << config.threads << '\n';
+    configFile << config.compression << '\n';
     configFile.close();
 }
 
+// `text` as a number if that is all it holds, otherwise `fallback`.
+template <typename T>
+T parseNumber(std::string_view text, T fallback) {
+    T value{};
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && end == text.data() + text.size() ? value : fallback;
+}
+
 void loadConfig() {
+    // one value per line; `>>` would skip the empty line of an unset name
+    // or email and read the next value in its place
     std::ifstream configFile(".vitconfig");
-    configFile >> config.localAI;
-    configFile >> config.userName;
-    configFile >> config.userEmail;
+    std::string line;
+    if (std::getline(configFile, line)) config.localAI = line != "0";
+    std::getline(configFile, config.userName);
+    std::getline(configFile, config.userEmail);
+    // older config files end before these; a malformed value keeps the default
+    if (std::getline(configFile, line)) config.threads = parseNumber(line, config.threads);
+    if (std::getline(configFile, line))
+        config.compression = std::clamp(parseNumber(line, config.compression), -1, 9);
     configFile.close();
 }
 
-bool handleInit() {
+bool handleInit(int argc, char *argv[]) {
+    auto codec = vit::storage::ObjectCodec::Zlib;
+    for (int i = 2; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--object-compression=zstd") {
+            codec = vit::storage::ObjectCodec::Zstd;
+        } else if (arg != "--object-compression=zlib") {
+            std::cerr << "Usage: init [--object-compression=zlib|zstd]\n";
+            return false;
+        }
+    }
+    if (codec == vit::storage::ObjectCodec::Zstd && !vit::storage::zstdAvailable()) {
+        std::cerr << "vit was built without zstd support\n";
+        return false;
+    }
+
     try {
         std::filesystem::create_directory(".git");
         std::filesystem::create_directory(".git/objects");
@@ -57,7 +109,15 @@ bool handleInit() {
             return false;
         }
 
-        std::cout << "Initialized vit directory\n";
+        // zstd objects are unreadable to git, so the repository says so
+        if (!vit::storage::recordObjectCodec(codec)) {
+            std::cerr << "Failed to write .git/config.\n";
+            return false;
+        }
+
+        std::cout << "Initialized vit directory";
+        if (codec == vit::storage::ObjectCodec::Zstd) std::cout << " (zstd objects)";
+        std::cout << '\n';
         return true;
     } catch (const std::filesystem::filesystem_error& e) {
         std::cerr << e.what() << '\n';
@@ -67,17 +127,32 @@ bool handleInit() {
 
 bool handleCatFile(int argc, char *argv[]) {
     if (argc < 4) {
-        std::cerr << "Usage: cat-file -p <hash>\n";
+        std::cerr << "Usage: cat-file (-p|-t|-s) <hash>\n";
         return false;
     }
     
     std::string flag = argv[2];
-    if (flag != "-p") {
+    if (flag != "-p" && flag != "-t" && flag != "-s") {
         std::cerr << "Unknown flag: " << flag << '\n';
         return false;
     }
 
-    std::string objectHash = argv[3];
+    const ObjectId objectHash = ObjectId::fromHex(argv[3]);
+    if (objectHash.isNull()) {
+        std::cerr << "Object not found: " << argv[3] << '\n';
+        return false;
+    }
+    if (flag != "-p") {
+        vit::storage::ObjectType type;
+        uint64_t size;
+        if (!vit::storage::peekObjectHeader(objectHash, type, size)) {
+            return false;
+        }
+        if (flag == "-t") std::cout << vit::storage::typeName(type) << '\n';
+        else              std::cout << size << '\n';
+        return true;
+    }
+
     std::string content = readObjectContent(objectHash);
     if (content.empty()) {
         return false;
@@ -100,22 +175,12 @@ bool handleHashObject(int argc, char *argv[]) {
     }
 
     std::string file = argv[3];
-    std::ifstream fileStream(file);
-    if (!fileStream.is_open()) {
-        std::cerr << "Failed to open file: " << file << '\n';
-        return false;
-    }
-    
-    std::stringstream contentStream;
-    contentStream << fileStream.rdbuf();
-    std::string fileContent = contentStream.str();
-
-    std::string hashString = writeBlob(fileContent);
-    if (hashString.empty()) {
+    const ObjectId hash = writeBlobFile(file);
+    if (hash.isNull()) {
         return false;
     }
     
-    std::cout << hashString << '\n';
+    std::cout << hash << '\n';
     return true;
 }
 
@@ -132,20 +197,20 @@ bool handleLsTree(int argc, char *argv[]) {
         return false;
     }
     
-    std::string treeHash = argv[2];
-    std::vector<FileInfo> files = parseTree(treeHash);
+    const ObjectId treeHash = ObjectId::fromHex(argv[2]);
+    const vit::storage::TreeView tree(treeHash);
     
-    if (files.empty()) {
-        std::cerr << "Tree not found or empty: " << treeHash << '\n';
+    if (tree.begin() == tree.end()) {
+        std::cerr << "Tree not found or empty: " << argv[2] << '\n';
         return false;
     }
     
-    for (const auto& file : files) {
+    for (const auto& file : tree) {
         if (nameOnly) {
             std::cout << file.name << '\n';
         } else {
-            std::string type = file.isDirectory ? "tree" : "blob";
-            std::cout << file.mode << " " << type << " " << file.hash << "\t" << file.name << '\n';
+            const char* type = file.isDirectory() ? "tree" : "blob";
+            std::cout << file.modeText << " " << type << " " << file.id << "\t" << file.name << '\n';
         }
     }
     
@@ -153,12 +218,12 @@ bool handleLsTree(int argc, char *argv[]) {
 }
 
 bool handleWriteTree() {
-    std::string hashString = writeTree(".");
-    if (hashString.empty()) {
+    const ObjectId hash = writeTree(".");
+    if (hash.isNull()) {
         std::cerr << "Failed to write tree\n";
         return false;
     }
-    std::cout << hashString << '\n';
+    std::cout << hash << '\n';
     return true;
 }
 
@@ -168,15 +233,19 @@ bool handleCommitTree(int argc, char *argv[]) {
         return false;
     }
 
-    std::string treeHash = argv[2];
-    std::string parentHash = argv[4];  // -p flag
+    const ObjectId treeHash = ObjectId::fromHex(argv[2]);
+    const ObjectId parentHash = ObjectId::fromHex(argv[4]);  // -p flag
     std::string message = argv[6];     // -m flag
+    if (treeHash.isNull() || parentHash.isNull()) {
+        std::cerr << "Invalid object name: " << (treeHash.isNull() ? argv[2] : argv[4]) << '\n';
+        return false;
+    }
     
     std::string author = config.userName;
     std::string email = config.userEmail;
 
-    std::string commitHash = writeCommit(treeHash, parentHash, message, author, email);
-    if (commitHash.empty()) {
+    const ObjectId commitHash = writeCommit(treeHash, parentHash, message, author, email);
+    if (commitHash.isNull()) {
         std::cerr << "Failed to create commit\n";
         return false;
     }
@@ -322,18 +391,18 @@ bool handleCommit(int argc, char *argv[]) {
     }
 
     // Commit everything (including review.md if generated)
-    std::string treeHash = writeTree(".");
-    if (treeHash.empty()) {
+    const ObjectId treeHash = writeTree(".");
+    if (treeHash.isNull()) {
         std::cerr << "Failed to create tree\n";
         return false;
     }
     
-    std::string parentHash = readHead();
+    const ObjectId parentHash = readHead();
     std::string author = config.userName;
     std::string email = config.userEmail;
     
-    std::string commitHash = writeCommit(treeHash, parentHash, message, author, email);
-    if (commitHash.empty()) {
+    const ObjectId commitHash = writeCommit(treeHash, parentHash, message, author, email);
+    if (commitHash.isNull()) {
         std::cerr << "Failed to create commit\n";
         return false;
     }
@@ -364,7 +433,7 @@ bool handleSplitCommit(int argc, char *argv[]) {
     }
     
     std::string message = argv[3];
-    std::string commitHash = readHead();
+    const ObjectId commitHash = readHead();
 
     std::unique_ptr<vit::ai::AIClient> client = setupAI(config.localAI);
 
@@ -397,8 +466,8 @@ bool handleSplitCommit(int argc, char *argv[]) {
 
 
 bool handleShowHead() {
-    std::string headHash = readHead();
-    if (headHash.empty()) {
+    const ObjectId headHash = readHead();
+    if (headHash.isNull()) {
         std::cout << "No commits yet\n";
     } else {
         std::cout << "HEAD: " << headHash << '\n';
@@ -407,35 +476,58 @@ bool handleShowHead() {
 }
 
 bool handleLog(int argc, char *argv[]) {
-    bool showAll = (argc >= 3 && std::string(argv[2]) == "--all");
-    std::string currentHead = readHead();
-
-    std::vector<std::string> hashesToShow;
-
-    if (showAll) {
-        hashesToShow = findAllCommitHashes();
-    } else {
-        std::vector<std::string> refs = {currentHead};
-        hashesToShow = getReachableCommits(refs);
+    const char* usage = "Usage: log [--all] [-n <count>] [--since=<date>] [--until=<date>] [-- <path>]\n";
+    bool showAll = false;
+    size_t maxCount = SIZE_MAX;
+    CommitWalkOptions options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--all") {
+            showAll = true;
+        } else if (arg == "-n" && i + 1 < argc) {
+            try {
+                maxCount = std::stoul(argv[++i]);
+            } catch (const std::exception&) {
+                std::cerr << "Invalid count: " << argv[i] << '\n';
+                return false;
+            }
+        } else if (arg.rfind("--since=", 0) == 0 || arg.rfind("--until=", 0) == 0) {
+            const std::string date = arg.substr(8);
+            int64_t& bound = arg[2] == 's' ? options.since : options.until;
+            if (!parseTimestamp(date, bound)) {
+                std::cerr << "Invalid date: " << date << '\n';
+                return false;
+            }
+        } else if (arg == "--" && i + 2 == argc) {
+            options.path = argv[++i];
+        } else {
+            std::cerr << usage;
+            return false;
+        }
     }
+    const ObjectId currentHead = readHead();
 
-    if (hashesToShow.empty()) {
+    std::vector<ObjectId> start;
+    if (showAll) start = findAllCommitHashes();
+    else if (!currentHead.isNull()) start.push_back(currentHead);
+    if (start.empty()) {
         std::cout << "No commits found\n";
         return true;
     }
 
-    for (const auto& hash : hashesToShow) {
-        CommitInfo commit = parseCommit(hash);
-        if (commit.hash.empty()) continue;
-
-        std::string headMark = (hash == currentHead) ? "   <-- HEAD" : "";
+    // the walk is lazy: stopping after `maxCount` commits reads no further
+    if (maxCount == 0) return true;
+    size_t shown = 0;
+    for (const auto& commit : walkCommitsByDate(std::move(start), options)) {
+        std::string headMark = (commit.id() == currentHead) ? "   <-- HEAD" : "";
 
-        std::cout << "commit " << commit.hash << headMark << '\n';
-        std::cout << "Author: " << commit.author << '\n';
-        std::cout << "Date:   " << formatTimestamp(commit.timestamp) << '\n';
+        std::cout << "commit " << commit.id() << headMark << '\n';
+        std::cout << "Author: " << commit.authorName() << '\n';
+        std::cout << "Date:   " << formatTimestamp(std::string(commit.authorTime())) << '\n';
         std::cout << '\n';
-        std::cout << "    " << commit.message << '\n';
+        std::cout << "    " << commit.message() << '\n';
         std::cout << '\n';
+        if (++shown == maxCount) break;
     }
 
     return true;
@@ -448,17 +540,19 @@ bool handleCheckout(int argc, char *argv[]) {
     }
     
     std::string target = argv[2];
-    std::string commitHash;
+    ObjectId commitHash;
     
     // Check if target is a branch name
     std::string branchPath = ".git/refs/heads/" + target;
     if (std::filesystem::exists(branchPath)) {
         // It's a branch name
         std::ifstream branchFile(branchPath);
-        std::getline(branchFile, commitHash);
+        std::string line;
+        std::getline(branchFile, line);
         branchFile.close();
+        commitHash = ObjectId::fromHex(line);
         
-        if (commitHash.empty()) {
+        if (commitHash.isNull()) {
             std::cerr << "Branch '" << target << "' has no commits\n";
             return false;
         }
@@ -474,7 +568,11 @@ bool handleCheckout(int argc, char *argv[]) {
         std::cout << "Switched to branch '" << target << "'\n";
     } else {
         // Assume it's a commit hash
-        commitHash = target;
+        commitHash = ObjectId::fromHex(target);
+        if (commitHash.isNull()) {
+            std::cerr << "Invalid commit: " << target << '\n';
+            return false;
+        }
         
         if (!safeCheckout(commitHash)) {
             return false;
@@ -486,33 +584,129 @@ bool handleCheckout(int argc, char *argv[]) {
     return true;
 }
 
-bool handleGC() {
+bool handleGC(int argc, char *argv[]) {
+    vit::storage::GcOptions options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        int64_t before = 0;
+        if (arg == "--prune=now") {
+            options.gracePeriod = 0;
+        } else if (arg.rfind("--prune=", 0) == 0 && parseTimestamp(arg.substr(8), before)) {
+            options.gracePeriod = std::max<int64_t>(0, std::time(nullptr) - before);
+        } else {
+            std::cerr << "Usage: gc [--prune=<date>|now]\n";
+            return false;
+        }
+    }
+
     std::cout << "Running garbage collection...\n";
-    
-    std::vector<std::string> allCommits = findAllCommitHashes();
-    std::vector<std::string> refs = collectReferenceCommits();
-    auto reachableVec = getReachableCommits(refs);
-    std::unordered_set<std::string> reachable(reachableVec.begin(),
-                                          reachableVec.end());
-
-    // delete unreachable commits
-    int deleted = 0;
-    for (const auto& hash : allCommits) {
-        std::string path = getObjectPath(hash);
-        if (reachable.count(hash) == 0) {
-            if (!std::filesystem::exists(path)) {
-                continue;
-            }
-            try {
-                std::filesystem::remove(path);
-                std::cout << "[GC] Deleted: " << hash << '\n';
-                ++deleted;
-            } catch (const std::filesystem::filesystem_error& e) {
-                std::cerr << "[GC] Failed to delete " << hash << ": " << e.what() << '\n';
+
+    const vit::storage::GcResult result = vit::storage::collectGarbage(options);
+    if (!result.success) {
+        std::cerr << "[GC] " << result.error << '\n';
+        return false;
+    }
+    std::cout << "Garbage collection complete. " << result.reachable << " objects reachable, "
+              << result.pruned << " deleted (" << result.bytesFreed / 1024 << " KiB reclaimed)";
+    if (result.kept) std::cout << ", " << result.kept << " recent unreachable objects kept";
+    std::cout << ".\n";
+    if (result.dictionarySamples)
+        std::cout << "Trained a zstd dictionary on " << result.dictionarySamples << " objects.\n";
+    if (!result.dictionaryError.empty()) std::cerr << "[GC] " << result.dictionaryError << '\n';
+
+    size_t graphCommits = 0;
+    if (!vit::storage::writeCommitGraph(collectReferenceCommits(), &graphCommits)) {
+        std::cerr << "[GC] Failed to write commit-graph\n";
+        return false;
+    }
+    std::cout << "Wrote commit-graph with " << graphCommits << " commits.\n";
+    return true;
+}
+
+bool handleCommitGraph(int argc, char *argv[]) {
+    if (argc != 3 || std::string(argv[2]) != "write") {
+        std::cerr << "Usage: commit-graph write\n";
+        return false;
+    }
+
+    size_t graphCommits = 0;
+    if (!vit::storage::writeCommitGraph(collectReferenceCommits(), &graphCommits)) {
+        std::cerr << "Failed to write commit-graph\n";
+        return false;
+    }
+    std::cout << "Wrote commit-graph with " << graphCommits << " commits.\n";
+    return true;
+}
+
+bool handleRepack(int argc, char *argv[]) {
+    vit::storage::RepackOptions options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        try {
+            if (arg == "-a") {
+                options.all = true;
+            } else if (arg.rfind("--window=", 0) == 0) {
+                options.window = std::stoi(arg.substr(9));
+            } else if (arg.rfind("--depth=", 0) == 0) {
+                options.depth = std::stoi(arg.substr(8));
+            } else {
+                std::cerr << "Usage: repack [-a] [--window=<n>] [--depth=<n>]\n";
+                return false;
             }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value: " << arg << '\n';
+            return false;
         }
     }
-    std::cout << "Garbage collection complete. " << deleted << " commits deleted.\n";
+
+    std::cout << "Packing " << (options.all ? "all" : "loose") << " objects...\n";
+
+    vit::storage::RepackResult result = vit::storage::repackObjects(options);
+    if (!result.success) {
+        std::cerr << "Repack failed: " << result.error << '\n';
+        return false;
+    }
+
+    if (result.packedObjects == 0) {
+        std::cout << "Nothing to pack.\n";
+        return true;
+    }
+
+    std::cout << "Packed " << result.packedObjects << " objects (" << result.deltas
+              << " deltified) into " << result.packPath << '\n';
+    std::cout << "Removed " << result.removedLoose << " loose objects";
+    if (result.removedPacks) {
+        std::cout << " and " << result.removedPacks << " old packs";
+    }
+    std::cout << ".\n";
+    if (result.bitmaps) {
+        std::cout << "Wrote reachability bitmaps for " << result.bitmaps << " commits.\n";
+    }
+    return true;
+}
+
+bool handleCountObjects() {
+    uint64_t looseBytes = 0;
+    const std::vector<ObjectId> loose = vit::storage::listLooseObjects();
+    for (const auto& id : loose) {
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(getObjectPath(id), ec);
+        if (!ec) looseBytes += size;
+    }
+    auto& packs = vit::storage::PackStore::instance();
+
+    std::cout << "count: " << loose.size() << '\n';
+    std::cout << "size: " << looseBytes / 1024 << " KiB\n";
+    std::cout << "in-pack: " << packs.objectHashes().size() << '\n';
+    std::cout << "packs: " << packs.packCount() << '\n';
+
+    size_t reachable = 0;
+    if (!vit::storage::countReachable(collectReferenceCommits(), reachable)) {
+        std::cerr << "Some reachable objects are missing\n";
+        return false;
+    }
+    std::cout << "reachable: " << reachable
+              << (vit::storage::BitmapIndex::instance().valid() ? " (from bitmaps)" : "") << '\n';
     return true;
 }
 
@@ -537,9 +731,9 @@ bool handleBranch(int argc, char *argv[]) {
     } else if (argc == 3) {
         // Create new branch
         std::string newBranchName = argv[2];
-        std::string currentCommit = readHead();
+        const ObjectId currentCommit = readHead();
         
-        if (currentCommit.empty()) {
+        if (currentCommit.isNull()) {
             std::cerr << "No commits yet - cannot create branch\n";
             return false;
         }
@@ -571,10 +765,37 @@ bool handleConfig(int argc, char *argv[]) {
         config.userName = argv[3];
     } else if (command == "user-email") {
         config.userEmail = argv[3];
+    } else if (command == "threads") {
+        if (argc < 4) {
+            std::cerr << "Usage: config threads <n>  (0 = one per core)\n";
+            return false;
+        }
+        const size_t threads = parseNumber(argv[3], SIZE_MAX);
+        if (threads == SIZE_MAX) {
+            std::cerr << "Invalid thread count: " << argv[3] << '\n';
+            return false;
+        }
+        config.threads = threads;
+    } else if (command == "compression") {
+        if (argc < 4) {
+            std::cerr << "Usage: config compression <level>  (0-9, -1 = zlib's default)\n";
+            return false;
+        }
+        const int level = parseNumber(argv[3], -2);
+        if (level < -1 || level > 9) {
+            std::cerr << "Invalid compression level: " << argv[3] << '\n';
+            return false;
+        }
+        config.compression = level;
     } else if (command == "print") {
         std::cout << "localAI: " << config.localAI << '\n';
         std::cout << "userName: " << config.userName << '\n';
         std::cout << "userEmail: " << config.userEmail << '\n';
+        std::cout << "threads: " << config.threads << '\n';
+        std::cout << "compression: " << config.compression
+                  << " (" << vit::storage::compressionBackend() << ")\n";
+        std::cout << "sha1: " << vit::storage::hashBackendName(vit::storage::hashBackend())
+                  << (vit::storage::multiBufferHashing() ? " (multi-buffer)" : "") << '\n';
     } else {
         std::cerr << "Unknown config command: " << command << '\n';
         return false;
@@ -584,11 +805,25 @@ bool handleConfig(int argc, char *argv[]) {
     return true;
 }
 
+void reportStats() {
+    if (!std::getenv("VIT_STATS")) return;
+
+    const auto s = vit::storage::ObjectCache::instance().stats();
+    std::cerr << "object cache: " << s.hits << " hits, " << s.misses << " misses, "
+              << s.evictions << " evictions, " << s.entries << " entries, "
+              << s.bytes / 1024 << " KiB of " << s.limit / 1024 << " KiB\n";
+
+    const auto w = vit::storage::KnownObjects::instance().stats();
+    std::cerr << "object writes: " << w.written << " written, " << w.elided << " elided\n";
+}
+
 int main(int argc, char *argv[]) {
     std::cout << std::unitbuf;
     std::cerr << std::unitbuf;
 
     loadConfig();
+    vit::utils::setWorkerThreads(config.threads);
+    vit::storage::setCompressionLevel(config.compression);
 
     if (argc < 2) {
         std::cerr << "No command provided.\n";
@@ -599,7 +834,7 @@ int main(int argc, char *argv[]) {
     bool success = false;
     
     if (command == "init") {
-        success = handleInit();
+        success = handleInit(argc, argv);
     } else if (command == "cat-file") {
         success = handleCatFile(argc, argv);
     } else if (command == "hash-object") {
@@ -621,7 +856,13 @@ int main(int argc, char *argv[]) {
     } else if (command == "checkout") {
         success = handleCheckout(argc, argv);
     } else if (command == "gc") {
-        success = handleGC();
+        success = handleGC(argc, argv);
+    } else if (command == "repack") {
+        success = handleRepack(argc, argv);
+    } else if (command == "count-objects") {
+        success = handleCountObjects();
+    } else if (command == "commit-graph") {
+        success = handleCommitGraph(argc, argv);
     } else if (command == "branch") {
         success = handleBranch(argc, argv);
     } else if (command == "config") {
@@ -631,6 +872,7 @@ int main(int argc, char *argv[]) {
         std::cerr << "Unknown command " << command << '\n';
         return EXIT_FAILURE;
     }
-    
+
+    reportStats();
     return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,282 @@
+#include "bitmap_index.hpp"
+#include "commit_graph.hpp"
+#include "commit_view.hpp"
+#include "ewah.hpp"
+#include "sha1.hpp"
+#include "tree_view.hpp"
+#include "../commit.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <unistd.h>
+
+namespace vit::storage {
+
+namespace {
+
+constexpr unsigned char BITMAP_MAGIC[4] = { 'V', 'B', 'M', 'P' };
+constexpr uint32_t      BITMAP_VERSION  = 1;
+constexpr size_t        HASH_SIZE       = ObjectId::RAW_SIZE;
+constexpr size_t        HEADER_SIZE     = 4 + 4 + HASH_SIZE + 4 + 4;
+
+// Commits get a bitmap every commits / MIN_BITMAPS commits of the history
+// walk, but no further apart than BITMAP_SPACING, so even a short history
+// has bitmaps below its tips. Long histories are spaced wider so that no
+// more than MAX_BITMAPS are written besides the ref tips.
+constexpr size_t MIN_BITMAPS    = 10;
+constexpr size_t BITMAP_SPACING = 100;
+constexpr size_t MAX_BITMAPS    = 400;
+
+uint32_t readBE32(const unsigned char* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+void appendBE32(std::string& out, uint32_t v)
+{
+    out += static_cast<char>(v >> 24);
+    out += static_cast<char>(v >> 16);
+    out += static_cast<char>(v >> 8);
+    out += static_cast<char>(v);
+}
+
+// ORs the stored bitmap of a commit into the bits; false if it has none.
+using StoredBitmaps = std::function<bool(const ObjectId& commit, std::vector<uint64_t>& bits)>;
+
+// Walks from `tips` back to the nearest commits with a stored bitmap, ORs
+// those in, then walks the trees of the commits in between, skipping any
+// tree already covered. Commits go first so that as many trees as possible
+// are covered before the tree walk starts.
+bool walkReachable(const StoredBitmaps& stored, const std::vector<ObjectId>& tips,
+                   const std::vector<ObjectId>& trees, Reachability& out)
+{
+    const auto& graph = CommitGraph::instance();
+
+    std::vector<ObjectId> commits(tips.rbegin(), tips.rend());
+    std::vector<ObjectId> pending(trees.rbegin(), trees.rend());
+    while (!commits.empty()) {
+        const ObjectId commit = commits.back();
+        commits.pop_back();
+        if (commit.isNull() || out.contains(commit) || stored(commit, out.bits)) continue;
+        out.mark(commit);
+
+        uint32_t pos;
+        std::vector<uint32_t> parents;
+        if (graph.lookup(commit, pos) && graph.parentsAt(pos, parents)) {
+            pending.push_back(graph.treeAt(pos));
+            for (uint32_t p : parents) commits.push_back(graph.idAt(p));
+            continue;
+        }
+        const CommitView view(commit);
+        if (!view.valid()) return false;
+        pending.push_back(view.tree());
+        for (const auto& parent : view.parents()) commits.push_back(parent);
+    }
+
+    while (!pending.empty()) {
+        const ObjectId tree = pending.back();
+        pending.pop_back();
+        if (!out.mark(tree)) continue;
+
+        const TreeView view(tree);
+        if (!view.valid()) return false;
+        for (const auto& e : view) {
+            if (e.mode == TreeMode::Gitlink) continue;   // a commit in another repository
+            if (e.isDirectory()) pending.push_back(e.id);
+            else                 out.mark(e.id);
+        }
+    }
+    return true;
+}
+
+uint64_t commitTime(const ObjectId& commit)
+{
+    const auto& graph = CommitGraph::instance();
+    uint32_t pos;
+    return graph.lookup(commit, pos) ? graph.commitTimeAt(pos) : CommitView(commit).committerTime();
+}
+
+} // namespace
+
+
+bool Reachability::mark(const ObjectId& id)
+{
+    size_t pos;
+    if (!pack || !pack->lookup(id, pos)) return outside.insert(id).second;
+
+    if (bits.size() <= pos / 64) bits.resize(pos / 64 + 1, 0);
+    uint64_t&      word = bits[pos / 64];
+    const uint64_t bit  = uint64_t(1) << (pos % 64);
+    if (word & bit) return false;
+    word |= bit;
+    return true;
+}
+
+bool Reachability::contains(const ObjectId& id) const
+{
+    size_t pos;
+    if (!pack || !pack->lookup(id, pos)) return outside.count(id) != 0;
+    return pos / 64 < bits.size() && (bits[pos / 64] >> (pos % 64)) & 1;
+}
+
+size_t Reachability::count() const
+{
+    size_t total = outside.size();
+    for (uint64_t w : bits) total += static_cast<size_t>(std::popcount(w));
+    return total;
+}
+
+
+BitmapIndex& BitmapIndex::instance()
+{
+    static BitmapIndex index;
+    static const bool  loaded = (index.reload(), true);
+    (void)loaded;
+    return index;
+}
+
+void BitmapIndex::reload()
+{
+    map_.close();
+    index_ = PackIndex();
+    bitmaps_.clear();
+
+    const std::string packDir = ".git/objects/pack";
+    std::error_code ec;
+    for (const auto& e : std::filesystem::directory_iterator(packDir, ec)) {
+        if (e.path().extension() == ".vbitmap" && open(e.path().string())) return;
+    }
+}
+
+bool BitmapIndex::open(const std::string& bitmapPath)
+{
+    auto fail = [this] {
+        map_.close();
+        index_ = PackIndex();
+        bitmaps_.clear();
+        return false;
+    };
+
+    const std::string idxPath = std::filesystem::path(bitmapPath).replace_extension(".idx").string();
+    if (!map_.open(bitmapPath) || !index_.open(idxPath)) return fail();
+
+    const unsigned char* p    = map_.data();
+    const size_t         size = map_.size();
+    if (size < HEADER_SIZE + HASH_SIZE ||
+        std::memcmp(p, BITMAP_MAGIC, sizeof(BITMAP_MAGIC)) != 0 ||
+        readBE32(p + 4) != BITMAP_VERSION ||
+        std::memcmp(p + 8, index_.packChecksum().data(), HASH_SIZE) != 0 ||
+        readBE32(p + 8 + HASH_SIZE) != index_.objectCount())
+        return fail();
+
+    // a damaged bitmap would silently drop objects from reachability, and
+    // gc would prune them; walk the history instead
+    if (hashBytes(p, size - HASH_SIZE) != ObjectId::fromRaw(p + size - HASH_SIZE)) {
+        std::cerr << "bitmap: checksum mismatch in " << bitmapPath << ", ignoring it\n";
+        return fail();
+    }
+
+    const uint32_t count = readBE32(p + 12 + HASH_SIZE);
+    size_t pos = HEADER_SIZE;
+    const size_t end = size - HASH_SIZE;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (end - pos < HASH_SIZE + 8) return fail();
+        const ObjectId commit = ObjectId::fromRaw(p + pos);
+        pos += HASH_SIZE;
+
+        const size_t bitmapSize = 8 + size_t(readBE32(p + pos + 4)) * 8 + 4;
+        if (end - pos < bitmapSize) return fail();
+        bitmaps_.emplace(commit, std::string_view(reinterpret_cast<const char*>(p + pos), bitmapSize));
+        pos += bitmapSize;
+    }
+    return pos == end || fail();
+}
+
+bool BitmapIndex::reachable(const std::vector<ObjectId>& tips, const std::vector<ObjectId>& trees,
+                            Reachability& out) const
+{
+    out.pack = &index_;
+    out.bits.assign((index_.objectCount() + 63) / 64, 0);
+    out.outside.clear();
+
+    const StoredBitmaps stored = [this](const ObjectId& commit, std::vector<uint64_t>& bits) {
+        const auto it = bitmaps_.find(commit);
+        return it != bitmaps_.end() && ewahOrInto(it->second, bits) != 0;
+    };
+    return walkReachable(stored, tips, trees, out);
+}
+
+
+bool writeBitmapIndex(const std::string& packPath, size_t* written)
+{
+    PackIndex index;
+    if (!index.open(std::filesystem::path(packPath).replace_extension(".idx").string())) return false;
+
+    // every ref tip, then commits spread evenly over the rest of history
+    const std::vector<ObjectId> tips    = collectReferenceCommits();
+    const std::vector<ObjectId> commits = getReachableCommits(tips);
+    const size_t spacing = std::max(std::clamp(commits.size() / MIN_BITMAPS, size_t(1), BITMAP_SPACING),
+                                    commits.size() / MAX_BITMAPS);
+
+    std::vector<ObjectId> selected = tips;
+    for (size_t i = spacing - 1; i < commits.size(); i += spacing) selected.push_back(commits[i]);
+    std::sort(selected.begin(), selected.end());
+    selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+
+    // oldest first, so each walk stops at the bitmaps of older commits
+    std::vector<std::pair<uint64_t, ObjectId>> byTime;
+    byTime.reserve(selected.size());
+    for (const auto& c : selected) byTime.emplace_back(commitTime(c), c);
+    std::sort(byTime.begin(), byTime.end());
+
+    std::unordered_map<ObjectId, std::string> built;
+    const StoredBitmaps stored = [&](const ObjectId& commit, std::vector<uint64_t>& bits) {
+        const auto it = built.find(commit);
+        return it != built.end() && ewahOrInto(it->second, bits) != 0;
+    };
+
+    std::string out(reinterpret_cast<const char*>(BITMAP_MAGIC), sizeof(BITMAP_MAGIC));
+    appendBE32(out, BITMAP_VERSION);
+    out += index.packChecksum();
+    appendBE32(out, static_cast<uint32_t>(index.objectCount()));
+    appendBE32(out, static_cast<uint32_t>(byTime.size()));
+
+    for (const auto& [time, commit] : byTime) {
+        Reachability r;
+        r.pack = &index;
+        r.bits.assign((index.objectCount() + 63) / 64, 0);
+        if (!walkReachable(stored, {commit}, {}, r) || !r.outside.empty()) return false;
+
+        std::string bitmap = ewahEncode(r.bits, static_cast<uint32_t>(index.objectCount()));
+        out += commit.raw();
+        out += bitmap;
+        built.emplace(commit, std::move(bitmap));
+    }
+
+    out += hashBytes(out.data(), out.size()).raw();
+
+    const std::string path    = std::filesystem::path(packPath).replace_extension(".vbitmap").string();
+    const std::string tmpPath = path + ".tmp" + std::to_string(::getpid());
+    std::error_code ec;
+    {
+        std::ofstream f(tmpPath, std::ios::binary);
+        if (!f.write(out.data(), out.size())) {
+            f.close();
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) return false;
+
+    BitmapIndex::instance().reload();
+    if (written) *written = byTime.size();
+    return true;
+}
+
+}
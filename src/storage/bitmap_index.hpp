@@ -0,0 +1,76 @@
+#pragma once
+#include "mapped_file.hpp"
+#include "object_id.hpp"
+#include "pack_index.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace vit::storage {
+
+// A set of reachable objects: one bit per object of a pack, numbered in
+// .idx order, plus the reachable objects that pack does not have.
+struct Reachability {
+    const PackIndex*             pack = nullptr;
+    std::vector<uint64_t>        bits;
+    std::unordered_set<ObjectId> outside;
+
+    // True if `id` was not marked before.
+    bool   mark(const ObjectId& id);
+    bool   contains(const ObjectId& id) const;
+    size_t count() const;
+};
+
+// pack-<hash>.vbitmap next to a pack: for a selection of commits (every
+// ref tip and a spread of older ones, at least every 100 commits of the
+// walk and closer in short histories), the EWAH-compressed bitmap
+// (storage/ewah.hpp) of every object reachable from it, all of which the
+// pack holds. The layout is vit's own, not git's .bitmap:
+//
+//   "VBMP", version (u32), checksum of the pack (20 bytes),
+//   object count (u32), bitmap count (u32),
+//   per bitmap: commit name (20 bytes), EWAH bitmap
+//   SHA-1 of everything above
+//
+// All integers are big-endian. A file whose trailing checksum does not
+// match is ignored, and reachability falls back to a full walk.
+class BitmapIndex {
+public:
+    // The bitmaps of the first pack that has valid ones, mapped on first use.
+    static BitmapIndex& instance();
+
+    // Re-reads the pack directory after packs were written or deleted. Not
+    // safe while other threads are reading the bitmaps.
+    void reload();
+
+    bool   valid() const { return map_.valid(); }
+    size_t bitmapCount() const { return bitmaps_.size(); }
+
+    // Everything reachable from the commits `tips` and the trees `trees`:
+    // the stored bitmaps of the nearest bitmapped commits ORed together,
+    // plus a walk over the commits (and their trees) between the tips and
+    // those commits. False if something on that walk could not be read.
+    bool reachable(const std::vector<ObjectId>& tips, const std::vector<ObjectId>& trees,
+                   Reachability& out) const;
+
+private:
+    BitmapIndex() = default;
+    bool open(const std::string& bitmapPath);
+
+    MappedFile                                     map_;
+    PackIndex                                      index_;
+    std::unordered_map<ObjectId, std::string_view> bitmaps_;   // into map_
+};
+
+// Writes the .vbitmap for the pack at `packPath`, selecting the commits
+// reachable from the refs. Fails without writing anything if the pack is
+// missing an object reachable from them, as every bitmap must cover the
+// whole of a commit's history.
+bool writeBitmapIndex(const std::string& packPath, size_t* written = nullptr);
+
+}
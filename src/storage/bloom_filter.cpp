@@ -0,0 +1,123 @@
+#include "bloom_filter.hpp"
+
+#include <unordered_set>
+
+namespace vit::storage {
+
+namespace {
+
+constexpr uint32_t SEED0 = 0x293ae76f;
+constexpr uint32_t SEED1 = 0x7e646e2c;
+
+uint32_t rotl(uint32_t v, int r)
+{
+    return (v << r) | (v >> (32 - r));
+}
+
+// Bytes are widened through a signed char, as git's version 1 filters do,
+// so paths with bytes >= 0x80 hash the same as in git.
+uint32_t widen(char c)
+{
+    return static_cast<uint32_t>(static_cast<int32_t>(static_cast<signed char>(c)));
+}
+
+// murmur3 x86_32.
+uint32_t murmur3(uint32_t seed, std::string_view data)
+{
+    constexpr uint32_t c1 = 0xcc9e2d51;
+    constexpr uint32_t c2 = 0x1b873593;
+
+    const size_t blocks = data.size() / 4;
+    for (size_t i = 0; i < blocks; ++i) {
+        uint32_t k = widen(data[4 * i]) | (widen(data[4 * i + 1]) << 8) |
+                     (widen(data[4 * i + 2]) << 16) | (widen(data[4 * i + 3]) << 24);
+        k *= c1;
+        k = rotl(k, 15);
+        k *= c2;
+        seed ^= k;
+        seed = rotl(seed, 13) * 5 + 0xe6546b64;
+    }
+
+    const char* tail = data.data() + blocks * 4;
+    uint32_t    k1   = 0;
+    switch (data.size() & 3) {
+    case 3: k1 ^= widen(tail[2]) << 16; [[fallthrough]];
+    case 2: k1 ^= widen(tail[1]) << 8;  [[fallthrough]];
+    case 1:
+        k1 ^= widen(tail[0]);
+        k1 *= c1;
+        k1 = rotl(k1, 15);
+        k1 *= c2;
+        seed ^= k1;
+        break;
+    }
+
+    seed ^= static_cast<uint32_t>(data.size());
+    seed ^= seed >> 16;
+    seed *= 0x85ebca6b;
+    seed ^= seed >> 13;
+    seed *= 0xc2b2ae35;
+    seed ^= seed >> 16;
+    return seed;
+}
+
+} // namespace
+
+
+BloomKey::BloomKey(std::string_view path)
+{
+    const uint32_t h0 = murmur3(SEED0, path);
+    const uint32_t h1 = murmur3(SEED1, path);
+    for (uint32_t i = 0; i < BloomSettings::HASH_COUNT; ++i) hashes_[i] = h0 + i * h1;
+}
+
+std::vector<BloomKey> bloomKeysForPath(std::string_view path)
+{
+    std::vector<BloomKey> keys;
+    while (!path.empty()) {
+        keys.emplace_back(path);
+        const size_t slash = path.rfind('/');
+        path = slash == std::string_view::npos ? std::string_view() : path.substr(0, slash);
+    }
+    return keys;
+}
+
+std::string buildBloomFilter(const std::vector<std::string>& paths)
+{
+    if (paths.size() > BloomSettings::MAX_CHANGED_PATHS) return std::string(1, '\xff');
+
+    std::unordered_set<std::string_view> entries;
+    for (std::string_view p : paths) {
+        while (!p.empty() && entries.insert(p).second) {
+            const size_t slash = p.rfind('/');
+            p = slash == std::string_view::npos ? std::string_view() : p.substr(0, slash);
+        }
+    }
+    if (entries.size() > BloomSettings::MAX_CHANGED_PATHS) return std::string(1, '\xff');
+
+    const size_t bytes = (entries.size() * BloomSettings::BITS_PER_ENTRY + 7) / 8;
+    std::string  filter(bytes ? bytes : 1, '\0');
+    const uint64_t bits = uint64_t(filter.size()) * 8;
+    for (const auto& e : entries) {
+        const BloomKey key(e);
+        for (uint32_t i = 0; i < BloomSettings::HASH_COUNT; ++i) {
+            const uint64_t bit = key.hash(i) % bits;
+            filter[bit / 8] = static_cast<char>(static_cast<unsigned char>(filter[bit / 8]) | (1u << (bit % 8)));
+        }
+    }
+    return filter;
+}
+
+bool bloomMaybeContains(std::string_view filter, const BloomKey& key)
+{
+    if (filter.empty()) return true;
+
+    const uint64_t bits = uint64_t(filter.size()) * 8;
+    for (uint32_t i = 0; i < BloomSettings::HASH_COUNT; ++i) {
+        const uint64_t bit = key.hash(i) % bits;
+        if (!(static_cast<unsigned char>(filter[bit / 8]) & (1u << (bit % 8)))) return false;
+    }
+    return true;
+}
+
+}
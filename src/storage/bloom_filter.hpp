@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vit::storage {
+
+// Changed-path Bloom filters as git stores them in the commit-graph
+// (BIDX/BDAT, version 1): every path a commit changes relative to its
+// first parent, plus each leading directory, is hashed with seeded
+// murmur3 into 7 bits of a filter sized at 10 bits per path. A query can
+// only answer "definitely not changed" or "maybe changed".
+struct BloomSettings {
+    static constexpr uint32_t VERSION           = 1;
+    static constexpr uint32_t HASH_COUNT        = 7;
+    static constexpr uint32_t BITS_PER_ENTRY    = 10;
+    static constexpr uint32_t MAX_CHANGED_PATHS = 512;
+};
+
+class BloomKey {
+public:
+    explicit BloomKey(std::string_view path);
+
+    uint32_t hash(size_t i) const { return hashes_[i]; }
+
+private:
+    uint32_t hashes_[BloomSettings::HASH_COUNT];
+};
+
+// The keys of `path` and of each of its leading directories, the way a
+// filter is queried.
+std::vector<BloomKey> bloomKeysForPath(std::string_view path);
+
+// Builds the filter for a commit whose first-parent diff touched `paths`
+// (files only; leading directories are added here). More than
+// MAX_CHANGED_PATHS entries give the one-byte all-ones filter that
+// matches everything; none gives a single zero byte.
+std::string buildBloomFilter(const std::vector<std::string>& paths);
+
+// False only if `key` was certainly never added. An empty filter means
+// none was computed, so it matches everything.
+bool bloomMaybeContains(std::string_view filter, const BloomKey& key);
+
+}
@@ -0,0 +1,631 @@
+#include "commit_graph.hpp"
+#include "bloom_filter.hpp"
+#include "commit_view.hpp"
+#include "sha1.hpp"
+#include "tree_view.hpp"
+#include "../utils/thread_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <unistd.h>
+
+namespace vit::storage {
+
+namespace {
+
+constexpr unsigned char GRAPH_MAGIC[4] = { 'C', 'G', 'P', 'H' };
+constexpr uint8_t       GRAPH_VERSION  = 1;
+constexpr uint8_t       HASH_VERSION   = 1;   // SHA-1
+constexpr size_t        HEADER_SIZE    = 8;
+constexpr size_t        CHUNK_ENTRY    = 12;
+constexpr size_t        HASH_SIZE      = ObjectId::RAW_SIZE;
+constexpr size_t        DATA_SIZE      = HASH_SIZE + 16;
+
+constexpr uint32_t CHUNK_FANOUT = 0x4f494446;   // "OIDF"
+constexpr uint32_t CHUNK_NAMES  = 0x4f49444c;   // "OIDL"
+constexpr uint32_t CHUNK_DATA   = 0x43444154;   // "CDAT"
+constexpr uint32_t CHUNK_EDGES  = 0x45444745;   // "EDGE"
+constexpr uint32_t CHUNK_BIDX   = 0x42494458;   // "BIDX"
+constexpr uint32_t CHUNK_BDAT   = 0x42444154;   // "BDAT"
+constexpr uint32_t CHUNK_BASE   = 0x42415345;   // "BASE"
+constexpr size_t   BDAT_HEADER  = 12;           // version, hash count, bits per entry
+
+constexpr uint32_t NO_PARENT   = 0x70000000;
+constexpr uint32_t EDGE_MARKER = 0x80000000;   // second parent slot: index into EDGE
+constexpr uint32_t LAST_EDGE   = 0x80000000;
+
+uint32_t readBE32(const unsigned char* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+uint64_t readBE64(const unsigned char* p)
+{
+    return (uint64_t(readBE32(p)) << 32) | readBE32(p + 4);
+}
+
+void appendBE32(std::string& out, uint32_t v)
+{
+    out += static_cast<char>(v >> 24);
+    out += static_cast<char>(v >> 16);
+    out += static_cast<char>(v >> 8);
+    out += static_cast<char>(v);
+}
+
+void appendBE64(std::string& out, uint64_t v)
+{
+    appendBE32(out, static_cast<uint32_t>(v >> 32));
+    appendBE32(out, static_cast<uint32_t>(v));
+}
+
+struct GraphCommit {
+    ObjectId              id;
+    ObjectId              tree;
+    std::vector<ObjectId> parents;
+    uint64_t              time       = 0;
+    uint32_t              generation = 0;   // 0 until computed
+    std::string           bloom;            // empty until computed
+};
+
+// Every commit reachable from `tips` that is not among the first `base`
+// positions of `old`, with entries of `old` reused as is. Walks stop at
+// commits in those base layers.
+bool collectCommits(const CommitGraph& old, uint32_t base, const std::vector<ObjectId>& tips,
+                    std::vector<GraphCommit>& commits)
+{
+    std::unordered_set<ObjectId> seen;
+    std::queue<ObjectId> q;
+    auto visit = [&](const ObjectId& id) {
+        uint32_t pos;
+        if (seen.insert(id).second && !(old.lookup(id, pos) && pos < base)) q.push(id);
+    };
+    for (const auto& t : tips) if (!t.isNull()) visit(t);
+
+    std::vector<uint32_t> parentPos;
+    while (!q.empty()) {
+        GraphCommit c;
+        c.id = q.front(); q.pop();
+
+        uint32_t pos;
+        if (old.lookup(c.id, pos)) {
+            parentPos.clear();
+            if (!old.parentsAt(pos, parentPos)) return false;
+            c.tree       = old.treeAt(pos);
+            c.time       = old.commitTimeAt(pos);
+            c.generation = old.generationAt(pos);
+            for (uint32_t p : parentPos) c.parents.push_back(old.idAt(p));
+            c.bloom = old.bloomFilterAt(pos);
+        } else {
+            const CommitView view(c.id);
+            if (!view.valid()) {
+                std::cerr << "commit-graph: cannot read commit " << c.id << '\n';
+                return false;
+            }
+            c.tree    = view.tree();
+            c.time    = view.committerTime();
+            c.parents = view.parents();
+        }
+
+        for (const auto& p : c.parents) visit(p);
+        commits.push_back(std::move(c));
+    }
+    return true;
+}
+
+// Sorts `commits` by name and returns the position of each.
+std::unordered_map<ObjectId, uint32_t> sortCommits(std::vector<GraphCommit>& commits)
+{
+    std::sort(commits.begin(), commits.end(),
+              [](const GraphCommit& a, const GraphCommit& b){ return a.id < b.id; });
+    std::unordered_map<ObjectId, uint32_t> index;
+    index.reserve(commits.size());
+    for (uint32_t i = 0; i < commits.size(); ++i) index.emplace(commits[i].id, i);
+    return index;
+}
+
+// Topological levels: 1 for a root, otherwise one more than the highest
+// parent. Parents outside `commits` are in a base layer of `old`.
+// Iterative so long histories cannot overflow the stack.
+void computeGenerations(std::vector<GraphCommit>& commits,
+                        const std::unordered_map<ObjectId, uint32_t>& index,
+                        const CommitGraph& old)
+{
+    std::vector<uint32_t> stack;
+    for (uint32_t start = 0; start < commits.size(); ++start) {
+        if (commits[start].generation) continue;
+        stack.push_back(start);
+        while (!stack.empty()) {
+            GraphCommit& c = commits[stack.back()];
+            if (c.generation) { stack.pop_back(); continue; }
+
+            uint32_t level = 0;
+            bool     ready = true;
+            for (const auto& p : c.parents) {
+                const auto it = index.find(p);
+                uint32_t   pos;
+                if (it == index.end()) {
+                    if (old.lookup(p, pos)) level = std::max(level, old.generationAt(pos));
+                } else if (!commits[it->second].generation) {
+                    stack.push_back(it->second);
+                    ready = false;
+                } else {
+                    level = std::max(level, commits[it->second].generation);
+                }
+            }
+            if (!ready) continue;
+            c.generation = std::min(level + 1, CommitGraph::GENERATION_MAX);
+            stack.pop_back();
+        }
+    }
+}
+
+std::string changedPathFilter(const ObjectId& parentTree, const ObjectId& tree)
+{
+    std::vector<std::string> paths;
+    diffTrees(parentTree, tree, [&](const std::string& path, const TreeViewEntry*, const TreeViewEntry*) {
+        paths.push_back(path);
+        return paths.size() <= BloomSettings::MAX_CHANGED_PATHS;
+    });
+    return buildBloomFilter(paths);
+}
+
+// Fills in the filters the old graph did not have, diffing each commit
+// against its first parent on the worker pool.
+void computeBloomFilters(std::vector<GraphCommit>& commits,
+                         const std::unordered_map<ObjectId, uint32_t>& index,
+                         const CommitGraph& old)
+{
+    constexpr size_t BATCH = 256;
+
+    std::vector<uint32_t> missing;
+    for (uint32_t i = 0; i < commits.size(); ++i)
+        if (commits[i].bloom.empty()) missing.push_back(i);
+    if (missing.empty()) return;
+
+    vit::utils::ThreadPool pool;
+    for (size_t begin = 0; begin < missing.size(); begin += BATCH) {
+        pool.submit([&, begin] {
+            const size_t end = std::min(begin + BATCH, missing.size());
+            for (size_t i = begin; i < end; ++i) {
+                GraphCommit& c = commits[missing[i]];
+                ObjectId     parentTree;
+                if (!c.parents.empty()) {
+                    const auto it = index.find(c.parents[0]);
+                    uint32_t   pos;
+                    if (it != index.end())                    parentTree = commits[it->second].tree;
+                    else if (old.lookup(c.parents[0], pos))   parentTree = old.treeAt(pos);
+                }
+                c.bloom = changedPathFilter(parentTree, c.tree);
+            }
+        });
+    }
+    pool.wait();
+}
+
+// The graph file for `commits`, sorted and indexed by sortCommits(), as a
+// layer on the first `base` positions of `old` whose checksums are `bases`.
+// Parents outside `commits` are looked up there.
+std::string serializeGraph(const std::vector<GraphCommit>& commits,
+                           const std::unordered_map<ObjectId, uint32_t>& index,
+                           const CommitGraph& old, uint32_t base,
+                           const std::vector<ObjectId>& bases)
+{
+    auto position = [&](const ObjectId& id) {
+        const auto it = index.find(id);
+        if (it != index.end()) return base + it->second;
+        uint32_t pos = NO_PARENT;
+        old.lookup(id, pos);
+        return pos;
+    };
+
+    std::string names, data, edges, bloomIndex, bloomData;
+    names.reserve(commits.size() * HASH_SIZE);
+    data.reserve(commits.size() * DATA_SIZE);
+    uint32_t fanout[256] = {};
+    for (const auto& c : commits) {
+        ++fanout[c.id.bytes[0]];
+        names += c.id.raw();
+        data  += c.tree.raw();
+
+        const size_t n = c.parents.size();
+        appendBE32(data, n > 0 ? position(c.parents[0]) : NO_PARENT);
+        if (n <= 2) {
+            appendBE32(data, n == 2 ? position(c.parents[1]) : NO_PARENT);
+        } else {
+            appendBE32(data, EDGE_MARKER | static_cast<uint32_t>(edges.size() / 4));
+            for (size_t i = 1; i < n; ++i)
+                appendBE32(edges, position(c.parents[i]) | (i + 1 == n ? LAST_EDGE : 0));
+        }
+        appendBE32(data, (c.generation << 2) | static_cast<uint32_t>((c.time >> 32) & 3));
+        appendBE32(data, static_cast<uint32_t>(c.time));
+
+        bloomData += c.bloom;
+        appendBE32(bloomIndex, static_cast<uint32_t>(bloomData.size()));
+    }
+    for (int i = 1; i < 256; ++i) fanout[i] += fanout[i - 1];
+
+    struct Chunk { uint32_t id; const std::string* body; };
+    std::string fanoutBody;
+    for (uint32_t n : fanout) appendBE32(fanoutBody, n);
+    std::vector<Chunk> chunks = {
+        { CHUNK_FANOUT, &fanoutBody }, { CHUNK_NAMES, &names }, { CHUNK_DATA, &data } };
+    std::string bloomBody;
+    appendBE32(bloomBody, BloomSettings::VERSION);
+    appendBE32(bloomBody, BloomSettings::HASH_COUNT);
+    appendBE32(bloomBody, BloomSettings::BITS_PER_ENTRY);
+    bloomBody += bloomData;
+    if (!edges.empty()) chunks.push_back({ CHUNK_EDGES, &edges });
+    chunks.push_back({ CHUNK_BIDX, &bloomIndex });
+    chunks.push_back({ CHUNK_BDAT, &bloomBody });
+    std::string baseBody;
+    for (const auto& b : bases) baseBody += b.raw();
+    if (!bases.empty()) chunks.push_back({ CHUNK_BASE, &baseBody });
+
+    std::string out(reinterpret_cast<const char*>(GRAPH_MAGIC), sizeof(GRAPH_MAGIC));
+    out += static_cast<char>(GRAPH_VERSION);
+    out += static_cast<char>(HASH_VERSION);
+    out += static_cast<char>(chunks.size());
+    out += static_cast<char>(bases.size());
+
+    uint64_t offset = HEADER_SIZE + (chunks.size() + 1) * CHUNK_ENTRY;
+    for (const auto& c : chunks) {
+        appendBE32(out, c.id);
+        appendBE64(out, offset);
+        offset += c.body->size();
+    }
+    appendBE32(out, 0);
+    appendBE64(out, offset);
+    for (const auto& c : chunks) out += *c.body;
+
+    out += hashBytes(out.data(), out.size()).raw();
+    return out;
+}
+
+// Writes `bytes` to a temporary file next to `path` and renames it over
+// `path`, so readers see either the old file or the whole new one.
+bool replaceFile(const std::string& path, std::string_view bytes)
+{
+    const std::string tmpPath = path + ".tmp" + std::to_string(::getpid());
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    {
+        std::ofstream f(tmpPath, std::ios::binary);
+        if (!f.write(bytes.data(), bytes.size()) || !f.flush()) {
+            f.close();
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) std::filesystem::remove(tmpPath, ec);
+    return !ec;
+}
+
+std::string layerPath(const ObjectId& checksum)
+{
+    return (std::filesystem::path(commitGraphChainPath()).parent_path() /
+            ("graph-" + checksum.hex() + ".graph")).string();
+}
+
+} // namespace
+
+
+CommitGraph& CommitGraph::instance()
+{
+    static CommitGraph graph;
+    static const bool  opened = (graph.open(), true);
+    (void)opened;
+    return graph;
+}
+
+void CommitGraph::reload()
+{
+    layers_.clear();
+    count_ = 0;
+    split_ = false;
+    open();
+}
+
+void CommitGraph::open()
+{
+    Layer single;
+    if (openLayer(commitGraphPath(), single) && single.baseCount == 0) {
+        count_ = single.count;
+        layers_.push_back(std::move(single));
+        return;
+    }
+
+    // a split graph: use the layers up to the first one that does not fit
+    // on the ones below it
+    std::ifstream chain(commitGraphChainPath());
+    std::string   line;
+    while (std::getline(chain, line)) {
+        const ObjectId checksum = ObjectId::fromHex(line);
+        Layer          layer;
+        if (checksum.isNull() || !openLayer(layerPath(checksum), layer) ||
+            layer.checksum != checksum || layer.baseCount != layers_.size())
+            break;
+        bool basesMatch = true;
+        for (size_t i = 0; i < layer.baseCount; ++i)
+            basesMatch &= std::memcmp(layer.baseNames + i * HASH_SIZE, layers_[i].checksum.data(), HASH_SIZE) == 0;
+        if (!basesMatch || uint64_t(count_) + layer.count >= NO_PARENT) break;
+
+        layer.base = count_;
+        count_    += layer.count;
+        layers_.push_back(std::move(layer));
+    }
+    split_ = !layers_.empty();
+}
+
+bool CommitGraph::openLayer(const std::string& path, Layer& layer)
+{
+    MappedFile& map = layer.map;
+    if (!std::filesystem::exists(path) || !map.open(path)) return false;
+
+    const unsigned char* p    = map.data();
+    const size_t         size = map.size();
+    if (size < HEADER_SIZE + CHUNK_ENTRY + HASH_SIZE ||
+        std::memcmp(p, GRAPH_MAGIC, sizeof(GRAPH_MAGIC)) != 0 ||
+        p[4] != GRAPH_VERSION || p[5] != HASH_VERSION) {
+        map.close();
+        return false;
+    }
+
+    const size_t chunks = p[6];
+    if (HEADER_SIZE + (chunks + 1) * CHUNK_ENTRY > size - HASH_SIZE) {
+        map.close();
+        return false;
+    }
+
+    size_t namesSize = 0, dataSize = 0, edgesSize = 0, baseSize = 0, bidxSize = 0, bdatSize = 0;
+    const unsigned char* bidx = nullptr;
+    const unsigned char* bdat = nullptr;
+    for (size_t i = 0; i < chunks; ++i) {
+        const unsigned char* e     = p + HEADER_SIZE + i * CHUNK_ENTRY;
+        const uint32_t       id    = readBE32(e);
+        const uint64_t       begin = readBE64(e + 4);
+        const uint64_t       end   = readBE64(e + 4 + CHUNK_ENTRY);
+        if (begin > end || end > size - HASH_SIZE) {
+            map.close();
+            return false;
+        }
+        switch (id) {
+        case CHUNK_FANOUT: if (end - begin == 256 * 4) layer.fanout = p + begin; break;
+        case CHUNK_NAMES:  layer.names     = p + begin; namesSize = end - begin; break;
+        case CHUNK_DATA:   layer.data      = p + begin; dataSize  = end - begin; break;
+        case CHUNK_EDGES:  layer.edges     = p + begin; edgesSize = end - begin; break;
+        case CHUNK_BASE:   layer.baseNames = p + begin; baseSize  = end - begin; break;
+        case CHUNK_BIDX:   bidx = p + begin; bidxSize = end - begin; break;
+        case CHUNK_BDAT:   bdat = p + begin; bdatSize = end - begin; break;
+        default: break;   // optional chunks this reader does not use
+        }
+    }
+
+    if (layer.fanout) layer.count = readBE32(layer.fanout + 255 * 4);
+    layer.baseCount = p[7];
+    if (!layer.fanout || !layer.names || !layer.data ||
+        namesSize != size_t(layer.count) * HASH_SIZE || dataSize != size_t(layer.count) * DATA_SIZE ||
+        baseSize != layer.baseCount * HASH_SIZE) {
+        map.close();
+        return false;
+    }
+    layer.edgeCount = edgesSize / 4;
+    layer.checksum  = ObjectId::fromRaw(p + size - HASH_SIZE);
+
+    // filters written with other settings cannot be queried with our keys
+    if (bidx && bdat && bidxSize == size_t(layer.count) * 4 && bdatSize >= BDAT_HEADER &&
+        readBE32(bdat) == BloomSettings::VERSION &&
+        readBE32(bdat + 4) == BloomSettings::HASH_COUNT &&
+        readBE32(bdat + 8) == BloomSettings::BITS_PER_ENTRY) {
+        layer.bloomIndex = bidx;
+        layer.bloomData  = bdat + BDAT_HEADER;
+        layer.bloomSize  = bdatSize - BDAT_HEADER;
+    }
+    return true;
+}
+
+const CommitGraph::Layer& CommitGraph::layerAt(uint32_t pos) const
+{
+    for (auto it = layers_.rbegin(); it != layers_.rend(); ++it)
+        if (pos >= it->base) return *it;
+    return layers_.front();
+}
+
+bool CommitGraph::lookup(const ObjectId& id, uint32_t& pos) const
+{
+    const unsigned char first = id.bytes[0];
+    for (const Layer& layer : layers_) {
+        uint32_t lo = first == 0 ? 0 : readBE32(layer.fanout + (first - 1) * 4);
+        uint32_t hi = readBE32(layer.fanout + first * 4);
+        if (hi > layer.count) continue;
+
+        while (lo < hi) {
+            const uint32_t mid = lo + (hi - lo) / 2;
+            const int cmp = std::memcmp(layer.names + size_t(mid) * HASH_SIZE, id.data(), HASH_SIZE);
+            if (cmp == 0) {
+                pos = layer.base + mid;
+                return true;
+            }
+            if (cmp < 0) lo = mid + 1;
+            else         hi = mid;
+        }
+    }
+    return false;
+}
+
+ObjectId CommitGraph::idAt(uint32_t pos) const
+{
+    const Layer& layer = layerAt(pos);
+    return ObjectId::fromRaw(layer.names + size_t(pos - layer.base) * HASH_SIZE);
+}
+
+ObjectId CommitGraph::treeAt(uint32_t pos) const
+{
+    const Layer& layer = layerAt(pos);
+    return ObjectId::fromRaw(layer.data + size_t(pos - layer.base) * DATA_SIZE);
+}
+
+bool CommitGraph::parentsAt(uint32_t pos, std::vector<uint32_t>& out) const
+{
+    // parents sit in this layer or one below it
+    const Layer&         layer = layerAt(pos);
+    const uint32_t       limit = layer.base + layer.count;
+    const unsigned char* d     = layer.data + size_t(pos - layer.base) * DATA_SIZE + HASH_SIZE;
+    const uint32_t       p1    = readBE32(d);
+    const uint32_t       p2    = readBE32(d + 4);
+
+    if (p1 == NO_PARENT) return true;
+    if (p1 >= limit) return false;
+    out.push_back(p1);
+
+    if (p2 == NO_PARENT) return true;
+    if (!(p2 & EDGE_MARKER)) {
+        if (p2 >= limit) return false;
+        out.push_back(p2);
+        return true;
+    }
+
+    // octopus merge: the remaining parents are listed in EDGE
+    for (size_t i = p2 & ~EDGE_MARKER; i < layer.edgeCount; ++i) {
+        const uint32_t e = readBE32(layer.edges + i * 4);
+        if ((e & ~LAST_EDGE) >= limit) return false;
+        out.push_back(e & ~LAST_EDGE);
+        if (e & LAST_EDGE) return true;
+    }
+    return false;
+}
+
+uint32_t CommitGraph::generationAt(uint32_t pos) const
+{
+    const Layer& layer = layerAt(pos);
+    return readBE32(layer.data + size_t(pos - layer.base) * DATA_SIZE + HASH_SIZE + 8) >> 2;
+}
+
+uint64_t CommitGraph::commitTimeAt(uint32_t pos) const
+{
+    const Layer&         layer = layerAt(pos);
+    const unsigned char* d     = layer.data + size_t(pos - layer.base) * DATA_SIZE + HASH_SIZE + 8;
+    return (uint64_t(readBE32(d) & 3) << 32) | readBE32(d + 4);
+}
+
+bool CommitGraph::hasBloomFilters() const
+{
+    return std::any_of(layers_.begin(), layers_.end(),
+                       [](const Layer& layer) { return layer.bloomIndex != nullptr; });
+}
+
+std::string_view CommitGraph::bloomFilterAt(uint32_t pos) const
+{
+    const Layer& layer = layerAt(pos);
+    if (!layer.bloomIndex) return {};
+    const uint32_t local = pos - layer.base;
+    const size_t   begin = local == 0 ? 0 : readBE32(layer.bloomIndex + (local - 1) * 4);
+    const size_t   end   = readBE32(layer.bloomIndex + size_t(local) * 4);
+    if (begin > end || end > layer.bloomSize) return {};
+    return std::string_view(reinterpret_cast<const char*>(layer.bloomData) + begin, end - begin);
+}
+
+
+std::string commitGraphPath()
+{
+    return ".git/objects/info/commit-graph";
+}
+
+std::string commitGraphChainPath()
+{
+    return ".git/objects/info/commit-graphs/commit-graph-chain";
+}
+
+bool writeCommitGraph(const std::vector<ObjectId>& tips, size_t* written)
+{
+    CommitGraph& old = CommitGraph::instance();
+
+    std::vector<GraphCommit> commits;
+    if (!collectCommits(old, 0, tips, commits)) return false;
+
+    const auto index = sortCommits(commits);
+    computeGenerations(commits, index, old);
+    computeBloomFilters(commits, index, old);
+
+    if (!replaceFile(commitGraphPath(), serializeGraph(commits, index, old, 0, {}))) return false;
+
+    // the single file now holds everything a chain had
+    std::error_code ec;
+    std::filesystem::remove_all(std::filesystem::path(commitGraphChainPath()).parent_path(), ec);
+
+    old.reload();
+    if (written) *written = commits.size();
+    return true;
+}
+
+bool updateCommitGraph(const ObjectId& commit)
+{
+    CommitGraph& graph = CommitGraph::instance();
+    uint32_t     pos;
+    if (!graph.valid() || graph.lookup(commit, pos)) return true;
+
+    std::vector<GraphCommit> commits;
+    if (!collectCommits(graph, graph.commitCount(), { commit }, commits)) return false;
+
+    // fold the layers on top into the new one while it would hold more
+    // than half as many commits as the layer below
+    size_t   keep = graph.layerCount();
+    uint64_t size = commits.size();
+    while (keep > 0 && size * 2 > graph.layerSize(keep - 1)) size += graph.layerSize(--keep);
+
+    uint32_t              base = 0;
+    std::vector<ObjectId> bases;
+    for (size_t i = 0; i < keep; ++i) {
+        base += graph.layerSize(i);
+        bases.push_back(graph.layerChecksum(i));
+    }
+    if (keep < graph.layerCount()) {
+        // keep everything already in the merged layers, reachable or not
+        std::vector<ObjectId> tips = { commit };
+        for (uint32_t i = base; i < graph.commitCount(); ++i) tips.push_back(graph.idAt(i));
+        commits.clear();
+        if (!collectCommits(graph, base, tips, commits)) return false;
+    }
+
+    const auto index = sortCommits(commits);
+    computeGenerations(commits, index, graph);
+    computeBloomFilters(commits, index, graph);
+
+    const std::string out      = serializeGraph(commits, index, graph, base, bases);
+    const ObjectId    checksum = ObjectId::fromRaw(out.data() + out.size() - HASH_SIZE);
+    if (!replaceFile(layerPath(checksum), out)) return false;
+
+    // a single file becomes the base of the chain; it would hide the chain
+    // if left in place
+    std::error_code ec;
+    if (!graph.split() && keep == 1) {
+        std::filesystem::rename(commitGraphPath(), layerPath(graph.layerChecksum(0)), ec);
+        if (ec) {
+            std::filesystem::remove(layerPath(checksum), ec);
+            return false;
+        }
+    }
+
+    std::string chain;
+    for (const auto& b : bases) chain += b.hex() + '\n';
+    chain += checksum.hex() + '\n';
+    if (!replaceFile(commitGraphChainPath(), chain)) return false;
+
+    if (!graph.split()) {
+        std::filesystem::remove(commitGraphPath(), ec);
+    } else {
+        for (size_t i = keep; i < graph.layerCount(); ++i)
+            if (graph.layerChecksum(i) != checksum) std::filesystem::remove(layerPath(graph.layerChecksum(i)), ec);
+    }
+
+    graph.reload();
+    return true;
+}
+
+}
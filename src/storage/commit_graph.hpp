@@ -0,0 +1,105 @@
+#pragma once
+#include "mapped_file.hpp"
+#include "object_id.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vit::storage {
+
+// .git/objects/info/commit-graph, in git's format (version 1, SHA-1): a
+// fanout table over sorted commit names, then per commit its tree, the
+// graph positions of its parents, its generation number (topological
+// level) and commit time. History walks read parents from here instead of
+// inflating every commit; commits missing from the graph are read from
+// their objects as before. The graph also carries a changed-path Bloom
+// filter per commit (storage/bloom_filter.hpp) for path-limited walks.
+//
+// A split graph is read the same way: commit-graphs/commit-graph-chain
+// lists layer files, base first, and each layer numbers its commits after
+// those of the layers below it. Positions are global across the chain. A
+// single commit-graph file takes precedence over a chain, as in git.
+class CommitGraph {
+public:
+    static constexpr uint32_t GENERATION_MAX = 0x3fffffff;
+
+    // The graph of the current repository, mapped on first use.
+    static CommitGraph& instance();
+
+    // Re-maps the file after it was rewritten. Not safe while other
+    // threads are reading the graph.
+    void reload();
+
+    bool valid() const { return !layers_.empty(); }
+
+    bool     lookup(const ObjectId& id, uint32_t& pos) const;
+    uint32_t commitCount() const { return count_; }
+    // The files the graph was read from, base first; one unless it is split.
+    bool     split() const { return split_; }
+    size_t   layerCount() const { return layers_.size(); }
+    uint32_t layerSize(size_t layer) const { return layers_[layer].count; }
+    ObjectId layerChecksum(size_t layer) const { return layers_[layer].checksum; }
+    ObjectId idAt(uint32_t pos) const;
+    ObjectId treeAt(uint32_t pos) const;
+    // Appends the positions of the parents, in order; false if the entry
+    // points outside the graph.
+    bool     parentsAt(uint32_t pos, std::vector<uint32_t>& out) const;
+    uint32_t generationAt(uint32_t pos) const;
+    uint64_t commitTimeAt(uint32_t pos) const;   // committer time, seconds
+
+    bool             hasBloomFilters() const;
+    // Empty if the graph has no filter for this commit.
+    std::string_view bloomFilterAt(uint32_t pos) const;
+
+private:
+    struct Layer {
+        MappedFile           map;
+        ObjectId             checksum;             // trailing hash of the file
+        uint32_t             base       = 0;       // commits in the layers below
+        uint32_t             count      = 0;
+        const unsigned char* fanout     = nullptr;
+        const unsigned char* names      = nullptr;
+        const unsigned char* data       = nullptr;
+        const unsigned char* edges      = nullptr;
+        size_t               edgeCount  = 0;
+        const unsigned char* baseNames  = nullptr; // BASE: checksums of the layers below
+        size_t               baseCount  = 0;
+        const unsigned char* bloomIndex = nullptr; // BIDX: end offset of each filter
+        const unsigned char* bloomData  = nullptr; // BDAT, past its header
+        size_t               bloomSize  = 0;
+    };
+
+    CommitGraph() = default;
+    void open();
+    static bool openLayer(const std::string& path, Layer& layer);
+    const Layer& layerAt(uint32_t pos) const;
+
+    std::vector<Layer> layers_;
+    uint32_t           count_ = 0;
+    bool               split_ = false;   // read from commit-graph-chain
+};
+
+std::string commitGraphPath();
+// The chain file of a split graph; its layers sit next to it as
+// graph-<checksum>.graph.
+std::string commitGraphChainPath();
+
+// Rewrites the graph as a single file holding every commit reachable from
+// `tips`, and removes any chain. Commits already in the current graph are
+// copied from it, Bloom filter included; only the others are read and
+// diffed against their first parent. `written` receives the number of
+// commits in the new graph.
+bool writeCommitGraph(const std::vector<ObjectId>& tips, size_t* written = nullptr);
+
+// Adds a new commit (and any of its ancestors the graph lacks) to an
+// existing graph as a new layer of a split graph, so a commit costs a few
+// entries rather than a rewrite of the whole history. Layers on top are
+// merged into the new one while it holds more than half as many commits
+// as the layer below, which keeps the chain logarithmic in the history;
+// gc folds it back into one file. Does nothing if the repository has no
+// graph yet.
+bool updateCommitGraph(const ObjectId& commit);
+
+}
@@ -0,0 +1,100 @@
+#include "commit_view.hpp"
+#include "object_store.hpp"
+
+#include <cstring>
+
+namespace vit::storage {
+
+CommitView::CommitView(const ObjectId& id) : id_(id)
+{
+    ObjectType type;
+    content_ = loadObjectShared(id, type);
+    if (content_ && type != ObjectType::Commit) content_.reset();
+    if (content_) scan();
+}
+
+CommitView::CommitView(const ObjectId& id, std::shared_ptr<const std::string> content)
+    : id_(id), content_(std::move(content))
+{
+    if (content_) scan();
+}
+
+// Header lines up to the first empty one, then the message. Only the
+// lines callers ask about are located; continuation lines (signatures)
+// and unknown headers are skipped.
+void CommitView::scan()
+{
+    const char* p   = content_->data();
+    const char* end = p + content_->size();
+    const char* parentsBegin = nullptr;
+    const char* parentsEnd   = nullptr;
+
+    while (p < end) {
+        const auto* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* lineEnd = nl ? nl : end;
+        const std::string_view line(p, lineEnd - p);
+        const char* next = nl ? nl + 1 : end;
+
+        if (line.empty()) {
+            message_ = std::string_view(next, end - next);
+            if (!message_.empty() && message_.back() == '\n') message_.remove_suffix(1);
+            break;
+        }
+
+        if (line.starts_with("tree ")) {
+            tree_ = line.substr(5);
+        } else if (line.starts_with("parent ")) {
+            // git writes parents back to back; a stray one elsewhere is ignored
+            if (line.size() + 1 == PARENT_LINE && nl && (!parentsBegin || parentsEnd == p)) {
+                if (!parentsBegin) parentsBegin = p;
+                parentsEnd = next;
+            }
+        } else if (line.starts_with("author ")) {
+            const size_t lt = line.find('<');
+            const size_t gt = line.find('>');
+            if (lt != std::string_view::npos && gt != std::string_view::npos && lt < gt) {
+                std::string_view name = line.substr(7, lt > 7 ? lt - 7 : 0);
+                while (!name.empty() && name.back() == ' ') name.remove_suffix(1);
+                authorName_ = name;
+                if (gt + 2 <= line.size()) authorTime_ = line.substr(gt + 2);
+            }
+        } else if (line.starts_with("committer ")) {
+            const size_t gt = line.rfind('>');
+            if (gt != std::string_view::npos && gt + 2 <= line.size()) committerTime_ = line.substr(gt + 2);
+        }
+        p = next;
+    }
+
+    if (parentsBegin) parentLines_ = std::string_view(parentsBegin, parentsEnd - parentsBegin);
+}
+
+ObjectId CommitView::tree() const
+{
+    return ObjectId::fromHex(tree_);
+}
+
+uint64_t CommitView::committerTime() const
+{
+    uint64_t t = 0;
+    for (const char c : committerTime_) {
+        if (c < '0' || c > '9') break;
+        t = t * 10 + static_cast<uint64_t>(c - '0');
+    }
+    return t;
+}
+
+ObjectId CommitView::parent(size_t i) const
+{
+    if (i >= parentCount()) return {};
+    return ObjectId::fromHex(parentLines_.substr(i * PARENT_LINE + 7, ObjectId::HEX_SIZE));
+}
+
+std::vector<ObjectId> CommitView::parents() const
+{
+    std::vector<ObjectId> out;
+    out.reserve(parentCount());
+    for (size_t i = 0; i < parentCount(); ++i) out.push_back(parent(i));
+    return out;
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "object_id.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vit::storage {
+
+// A commit read in place. The header is scanned once, when the view is
+// made, into views over the inflated buffer (which the view keeps alive);
+// tree and parent names are decoded from hex only when asked for, and
+// nothing is copied unless a caller wants an owning string. Commits may
+// have any number of parents.
+class CommitView {
+public:
+    CommitView() = default;
+    explicit CommitView(const ObjectId& id);   // through the object cache
+    CommitView(const ObjectId& id, std::shared_ptr<const std::string> content);
+
+    // False if the object could not be read or has no tree line.
+    bool            valid() const { return content_ != nullptr && !tree_.empty(); }
+    const ObjectId& id() const    { return id_; }
+
+    ObjectId              tree() const;
+    size_t                parentCount() const { return parentLines_.size() / PARENT_LINE; }
+    ObjectId              parent(size_t i) const;   // null if out of range or malformed
+    std::vector<ObjectId> parents() const;
+
+    std::string_view authorName() const { return authorName_; }
+    std::string_view authorTime() const { return authorTime_; }   // "<seconds> [<zone>]"
+    uint64_t         committerTime() const;                       // seconds, 0 if missing
+    std::string_view message() const    { return message_; }      // without its final newline
+
+private:
+    static constexpr size_t PARENT_LINE = 48;   // "parent " + 40 hex digits + '\n'
+
+    void scan();
+
+    ObjectId                           id_;
+    std::shared_ptr<const std::string> content_;
+    std::string_view                   tree_;
+    std::string_view                   parentLines_;   // the consecutive parent lines
+    std::string_view                   authorName_;
+    std::string_view                   authorTime_;
+    std::string_view                   committerTime_;
+    std::string_view                   message_;
+};
+
+}
@@ -0,0 +1,213 @@
+#include "compression.hpp"
+#include "zstd_codec.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <memory>
+
+#include <zlib.h>
+#ifdef VIT_HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+namespace vit::storage {
+
+namespace {
+
+std::atomic<int> configuredLevel{Z_DEFAULT_COMPRESSION};
+
+// Only this much of the content is looked at, and below MIN_SAMPLE the
+// byte counts say too little to go by.
+constexpr size_t ENTROPY_SAMPLE = 16 * 1024;
+constexpr size_t MIN_SAMPLE     = 1024;
+// Bits per byte above which deflate gains close to nothing. Text sits
+// around 4 to 5, machine code around 6, deflated or encrypted data just
+// under 8.
+constexpr double INCOMPRESSIBLE_ENTROPY = 7.5;
+
+struct Signature {
+    size_t           offset;
+    std::string_view bytes;
+};
+
+// Formats whose payload is already compressed.
+constexpr std::array<Signature, 13> SIGNATURES{{
+    { 0, { "\x89PNG\r\n\x1a\n", 8 } },
+    { 0, { "\xff\xd8\xff", 3 } },               // JPEG
+    { 0, { "GIF87a", 6 } },
+    { 0, { "GIF89a", 6 } },
+    { 8, { "WEBP", 4 } },                       // after "RIFF" and a size
+    { 4, { "ftyp", 4 } },                       // MP4, MOV, HEIF
+    { 0, { "\x1a\x45\xdf\xa3", 4 } },           // Matroska, WebM
+    { 0, { "OggS", 4 } },
+    { 0, { "PK\x03\x04", 4 } },                 // zip, jar, docx, apk
+    { 0, { "\x1f\x8b", 2 } },                   // gzip
+    { 0, { "\xfd" "7zXZ\x00", 6 } },            // xz
+    { 0, { "\x28\xb5\x2f\xfd", 4 } },           // zstd
+    { 0, { "7z\xbc\xaf\x27\x1c", 6 } },
+}};
+
+// bzip2 gets more than the table: "BZh" alone is a prefix plain text can
+// have, so the block size digit and the magic of the first block (pi)
+// must follow it.
+bool isBzip2(std::string_view sample)
+{
+    return sample.size() >= 10 && sample[3] >= '1' && sample[3] <= '9' &&
+           sample.substr(4, 6) == std::string_view("\x31\x41\x59\x26\x53\x59", 6);
+}
+
+double entropyBits(std::string_view sample)
+{
+    size_t counts[256] = {};
+    for (unsigned char c : sample) ++counts[c];
+
+    const double n = static_cast<double>(sample.size());
+    double bits = 0;
+    for (size_t c : counts) {
+        if (!c) continue;
+        const double p = static_cast<double>(c) / n;
+        bits -= p * std::log2(p);
+    }
+    return bits;
+}
+
+bool zlibCompressWithZlib(std::string_view data, int level, std::string& out)
+{
+    uLongf dstSize = compressBound(data.size());
+    out.assign(dstSize, '\0');
+    if (compress2(reinterpret_cast<Bytef*>(out.data()), &dstSize,
+                  reinterpret_cast<const Bytef*>(data.data()), data.size(), level) != Z_OK)
+        return false;
+    out.resize(dstSize);
+    return true;
+}
+
+#ifdef VIT_HAVE_LIBDEFLATE
+struct CompressorDeleter {
+    void operator()(libdeflate_compressor* c) const { libdeflate_free_compressor(c); }
+};
+
+// libdeflate compressors are not thread-safe and costly to set up, so
+// every thread keeps one per level it has used.
+libdeflate_compressor* compressorFor(int level)
+{
+    thread_local std::array<std::unique_ptr<libdeflate_compressor, CompressorDeleter>, 10> compressors;
+    auto& c = compressors[static_cast<size_t>(level)];
+    if (!c) c.reset(libdeflate_alloc_compressor(level));
+    return c.get();
+}
+#endif
+
+std::string trimmedLower(std::string_view s)
+{
+    const auto first = s.find_first_not_of(" \t\r");
+    const auto last  = s.find_last_not_of(" \t\r");
+    std::string out(first == std::string_view::npos ? std::string_view() : s.substr(first, last - first + 1));
+    for (char& c : out) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return out;
+}
+
+// Just enough of git's config syntax for extensions.objectcompression.
+ObjectCodec readObjectCodec()
+{
+    std::ifstream config(".git/config");
+    std::string   line, section;
+    ObjectCodec   codec = ObjectCodec::Zlib;
+    while (std::getline(config, line)) {
+        const std::string text = trimmedLower(line);
+        if (text.empty() || text[0] == '#' || text[0] == ';') continue;
+        if (text[0] == '[') {
+            section = trimmedLower(std::string_view(text).substr(1, text.find(']') - 1));
+            continue;
+        }
+        const auto eq = text.find('=');
+        if (section == "extensions" && eq != std::string::npos &&
+            trimmedLower(std::string_view(text).substr(0, eq)) == "objectcompression")
+            codec = trimmedLower(std::string_view(text).substr(eq + 1)) == "zstd" ? ObjectCodec::Zstd
+                                                                                   : ObjectCodec::Zlib;
+    }
+    return codec;
+}
+
+} // namespace
+
+int compressionLevel()
+{
+    return configuredLevel.load(std::memory_order_relaxed);
+}
+
+void setCompressionLevel(int level)
+{
+    configuredLevel.store(std::clamp(level, -1, 9), std::memory_order_relaxed);
+}
+
+bool looksIncompressible(std::string_view sample)
+{
+    if (sample.size() < MIN_SAMPLE) return false;
+    for (const auto& sig : SIGNATURES) {
+        if (sample.substr(sig.offset, sig.bytes.size()) == sig.bytes) return true;
+    }
+    if (isBzip2(sample)) return true;
+    return entropyBits(sample.substr(0, ENTROPY_SAMPLE)) > INCOMPRESSIBLE_ENTROPY;
+}
+
+int levelFor(std::string_view sample)
+{
+    return looksIncompressible(sample) ? 0 : compressionLevel();
+}
+
+bool zlibCompress(std::string_view data, int level, std::string& out)
+{
+#ifdef VIT_HAVE_LIBDEFLATE
+    if (level < 0) level = 6;   // zlib's default
+    // older libdeflate releases have no level 0; zlib stores just as well
+    if (libdeflate_compressor* c = compressorFor(level)) {
+        out.resize(libdeflate_zlib_compress_bound(c, data.size()));
+        const size_t n = libdeflate_zlib_compress(c, data.data(), data.size(), out.data(), out.size());
+        if (n) {
+            out.resize(n);
+            return true;
+        }
+    }
+#endif
+    return zlibCompressWithZlib(data, level, out);
+}
+
+const char* compressionBackend()
+{
+#ifdef VIT_HAVE_LIBDEFLATE
+    return "libdeflate";
+#else
+    return "zlib";
+#endif
+}
+
+ObjectCodec objectCodec()
+{
+    static const ObjectCodec codec = readObjectCodec();
+    return codec;
+}
+
+bool recordObjectCodec(ObjectCodec codec)
+{
+    if (codec == ObjectCodec::Zlib) return true;   // git's default needs no entry
+    // appended, so an existing config keeps everything else; git takes the
+    // last value of a key
+    std::ofstream config(".git/config", std::ios::app);
+    config << "[core]\n\trepositoryformatversion = 1\n"
+           << "[extensions]\n\tobjectcompression = zstd\n";
+    return static_cast<bool>(config);
+}
+
+bool compressObject(std::string_view object, int level, std::string& out)
+{
+    return objectCodec() == ObjectCodec::Zstd ? zstdCompress(object, level, out)
+                                              : zlibCompress(object, level, out);
+}
+
+}
+
@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace vit::storage {
+
+// Level the zlib streams of loose objects and pack entries are written at:
+// 0 (stored) to 9, or -1 for zlib's default. Set from the `compression`
+// config value; every level reads back the same with any inflater. zstd
+// objects use the same scale (zstd_codec.hpp has the mapping).
+int  compressionLevel();
+void setCompressionLevel(int level);
+
+// True if the content starting with `sample` will not shrink: it opens
+// with the signature of an already compressed format (PNG, JPEG, zip,
+// gzip, xz, zstd, ...) or its bytes are close to random. Samples shorter
+// than a kilobyte are never judged incompressible.
+bool looksIncompressible(std::string_view sample);
+
+// compressionLevel(), or 0 when `sample` looks incompressible, so that
+// media and archives are stored instead of being deflated for nothing
+// (with zstd, written at its fastest level).
+int levelFor(std::string_view sample);
+
+// Compresses `data` into a zlib stream at `level`, with libdeflate when
+// vit was built with it (VIT_HAVE_LIBDEFLATE) and zlib otherwise.
+bool zlibCompress(std::string_view data, int level, std::string& out);
+
+// "libdeflate" or "zlib".
+const char* compressionBackend();
+
+enum class ObjectCodec { Zlib, Zstd };
+
+// What new loose objects are compressed with: zlib, as git expects, or
+// zstd in repositories created with `vit init --object-compression=zstd`.
+// Those have extensions.objectcompression in .git/config, along with
+// repository format version 1, which makes git refuse to touch them.
+// Read once per process. Readers tell the two apart by the object itself.
+ObjectCodec objectCodec();
+
+// Records `codec` in .git/config at `vit init`.
+bool recordObjectCodec(ObjectCodec codec);
+
+// Compresses a whole loose object, header included, with objectCodec().
+bool compressObject(std::string_view object, int level, std::string& out);
+
+}
@@ -0,0 +1,213 @@
+#include "delta.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vit::storage {
+
+namespace {
+
+constexpr size_t BLOCK_SIZE     = 16;
+constexpr size_t CHAIN_LIMIT    = 64;       // candidates tried per target position
+constexpr size_t MAX_COPY_SIZE  = 0x10000;  // larger copies are split, as git does
+constexpr size_t MAX_INSERT     = 0x7f;
+
+uint32_t blockHash(const unsigned char* p)
+{
+    uint64_t a, b;
+    std::memcpy(&a, p, 8);
+    std::memcpy(&b, p + 8, 8);
+    const uint64_t h = a * 0x9E3779B97F4A7C15ull ^ (b + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+    return static_cast<uint32_t>(h >> 32);
+}
+
+void appendVarint(std::string& out, uint64_t v)
+{
+    do {
+        unsigned char c = v & 0x7f;
+        v >>= 7;
+        if (v) c |= 0x80;
+        out += static_cast<char>(c);
+    } while (v);
+}
+
+bool readVarint(const unsigned char*& p, const unsigned char* end, uint64_t& v)
+{
+    v = 0;
+    int shift = 0;
+    unsigned char c;
+    do {
+        if (p == end || shift > 63) return false;
+        c = *p++;
+        v |= static_cast<uint64_t>(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    return true;
+}
+
+void appendInsert(std::string& out, std::string_view data)
+{
+    while (!data.empty()) {
+        const size_t n = std::min(data.size(), MAX_INSERT);
+        out += static_cast<char>(n);
+        out.append(data.data(), n);
+        data.remove_prefix(n);
+    }
+}
+
+void appendCopy(std::string& out, uint64_t offset, uint64_t size)
+{
+    while (size) {
+        const uint64_t n = std::min<uint64_t>(size, MAX_COPY_SIZE);
+        unsigned char cmd = 0x80;
+        char bytes[7];
+        int  count = 0;
+        for (int i = 0; i < 4; ++i) {
+            if (const unsigned char b = (offset >> (8 * i)) & 0xff) {
+                cmd |= 1 << i;
+                bytes[count++] = static_cast<char>(b);
+            }
+        }
+        // a size of 0x10000 is encoded with no size bytes at all
+        for (int i = 0; i < 3; ++i) {
+            if (const unsigned char b = (n >> (8 * i)) & 0xff) {
+                cmd |= 0x10 << i;
+                bytes[count++] = static_cast<char>(b);
+            }
+        }
+        out += static_cast<char>(cmd);
+        out.append(bytes, count);
+        offset += n;
+        size   -= n;
+    }
+}
+
+} // namespace
+
+
+DeltaIndex::DeltaIndex(std::string_view source)
+    : source_(source)
+{
+    const size_t blocks = source_.size() / BLOCK_SIZE;
+    if (blocks == 0) return;
+
+    size_t tableSize = 1;
+    while (tableSize < blocks) tableSize <<= 1;
+    buckets_.assign(tableSize, 0);
+    next_.assign(blocks, 0);
+    mask_ = static_cast<uint32_t>(tableSize - 1);
+
+    const auto* src = reinterpret_cast<const unsigned char*>(source_.data());
+    // insert back to front so each chain lists earlier blocks first
+    for (size_t i = blocks; i-- > 0;) {
+        const uint32_t slot = blockHash(src + i * BLOCK_SIZE) & mask_;
+        next_[i]      = buckets_[slot];
+        buckets_[slot] = static_cast<uint32_t>(i + 1);
+    }
+}
+
+std::string DeltaIndex::createDelta(std::string_view target, size_t maxSize) const
+{
+    std::string out;
+    appendVarint(out, source_.size());
+    appendVarint(out, target.size());
+
+    const auto*  src   = reinterpret_cast<const unsigned char*>(source_.data());
+    const auto*  tgt   = reinterpret_cast<const unsigned char*>(target.data());
+    const size_t sSize = source_.size();
+    const size_t tSize = target.size();
+
+    size_t pos       = 0;
+    size_t insStart  = 0;
+    while (!buckets_.empty() && pos + BLOCK_SIZE <= tSize) {
+        size_t bestLen = 0, bestOff = 0;
+
+        size_t tried = 0;
+        for (uint32_t b = buckets_[blockHash(tgt + pos) & mask_]; b && tried < CHAIN_LIMIT;
+             b = next_[b - 1], ++tried) {
+            const size_t off   = size_t(b - 1) * BLOCK_SIZE;
+            const size_t limit = std::min(sSize - off, tSize - pos);
+            size_t len = 0;
+            while (len < limit && src[off + len] == tgt[pos + len]) ++len;
+            if (len > bestLen) {
+                bestLen = len;
+                bestOff = off;
+                if (len == limit) break;
+            }
+        }
+
+        if (bestLen < BLOCK_SIZE) {
+            ++pos;
+            continue;
+        }
+
+        // grow the match backwards over bytes we were about to insert
+        while (pos > insStart && bestOff > 0 && src[bestOff - 1] == tgt[pos - 1]) {
+            --pos;
+            --bestOff;
+            ++bestLen;
+        }
+
+        appendInsert(out, target.substr(insStart, pos - insStart));
+        appendCopy(out, bestOff, bestLen);
+        pos      += bestLen;
+        insStart  = pos;
+        if (out.size() > maxSize) return {};
+    }
+
+    appendInsert(out, target.substr(insStart));
+    if (out.size() > maxSize) return {};
+    return out;
+}
+
+
+bool applyDelta(std::string_view base, std::string_view delta, std::string& out)
+{
+    const auto* p   = reinterpret_cast<const unsigned char*>(delta.data());
+    const auto* end = p + delta.size();
+
+    uint64_t srcSize, tgtSize;
+    if (!readVarint(p, end, srcSize) || !readVarint(p, end, tgtSize)) return false;
+    if (srcSize != base.size()) return false;
+
+    out.resize(tgtSize);
+    size_t outPos = 0;
+    while (p < end) {
+        const unsigned char cmd = *p++;
+        if (cmd & 0x80) {
+            uint64_t offset = 0, size = 0;
+            for (int i = 0; i < 4; ++i)
+                if (cmd & (1 << i)) {
+                    if (p == end) return false;
+                    offset |= static_cast<uint64_t>(*p++) << (8 * i);
+                }
+            for (int i = 0; i < 3; ++i)
+                if (cmd & (0x10 << i)) {
+                    if (p == end) return false;
+                    size |= static_cast<uint64_t>(*p++) << (8 * i);
+                }
+            if (size == 0) size = 0x10000;
+            if (offset + size > base.size() || outPos + size > tgtSize) return false;
+            std::memcpy(out.data() + outPos, base.data() + offset, size);
+            outPos += size;
+        } else if (cmd) {
+            if (static_cast<size_t>(end - p) < cmd || outPos + cmd > tgtSize) return false;
+            std::memcpy(out.data() + outPos, p, cmd);
+            p      += cmd;
+            outPos += cmd;
+        } else {
+            return false;   // opcode 0 is reserved
+        }
+    }
+    return outPos == tgtSize;
+}
+
+bool deltaTargetSize(std::string_view delta, uint64_t& size)
+{
+    const auto* p   = reinterpret_cast<const unsigned char*>(delta.data());
+    const auto* end = p + delta.size();
+    uint64_t srcSize;
+    return readVarint(p, end, srcSize) && readVarint(p, end, size);
+}
+
+}
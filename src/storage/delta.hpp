@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vit::storage {
+
+// Fingerprints of every aligned block of a delta source, so that one source
+// can be matched against many candidate targets without re-scanning it.
+// The source must outlive the index.
+class DeltaIndex {
+public:
+    explicit DeltaIndex(std::string_view source);
+
+    // Encodes target as a git copy/insert delta against the indexed source.
+    // Returns an empty string once the delta would grow past maxSize bytes.
+    std::string createDelta(std::string_view target, size_t maxSize) const;
+
+    size_t sourceSize() const { return source_.size(); }
+
+private:
+    std::string_view      source_;
+    std::vector<uint32_t> buckets_;   // hash -> first block + 1, 0 when empty
+    std::vector<uint32_t> next_;      // block -> next block in the same bucket + 1
+    uint32_t              mask_ = 0;
+};
+
+// Rebuilds the target of a git delta. Fails on malformed deltas or when the
+// delta was made against a base of a different size.
+bool applyDelta(std::string_view base, std::string_view delta, std::string& out);
+
+// Reads the result size recorded in a delta header without applying it.
+bool deltaTargetSize(std::string_view delta, uint64_t& size);
+
+}
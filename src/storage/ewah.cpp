@@ -0,0 +1,112 @@
+#include "ewah.hpp"
+
+#include <algorithm>
+
+namespace vit::storage {
+
+namespace {
+
+constexpr uint64_t ALL_ONES     = ~uint64_t(0);
+constexpr uint64_t MAX_RUN      = (uint64_t(1) << 32) - 1;
+constexpr uint64_t MAX_LITERALS = (uint64_t(1) << 31) - 1;
+
+uint32_t readBE32(const unsigned char* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+uint64_t readBE64(const unsigned char* p)
+{
+    return (uint64_t(readBE32(p)) << 32) | readBE32(p + 4);
+}
+
+void appendBE32(std::string& out, uint32_t v)
+{
+    out += static_cast<char>(v >> 24);
+    out += static_cast<char>(v >> 16);
+    out += static_cast<char>(v >> 8);
+    out += static_cast<char>(v);
+}
+
+void appendBE64(std::string& out, uint64_t v)
+{
+    appendBE32(out, static_cast<uint32_t>(v >> 32));
+    appendBE32(out, static_cast<uint32_t>(v));
+}
+
+uint64_t markerWord(bool runBit, uint64_t runLength, uint64_t literals)
+{
+    return uint64_t(runBit) | (runLength << 1) | (literals << 33);
+}
+
+} // namespace
+
+std::string ewahEncode(const std::vector<uint64_t>& words, uint32_t bitCount)
+{
+    const size_t count = std::min<size_t>(words.size(), (size_t(bitCount) + 63) / 64);
+
+    std::vector<uint64_t> out;
+    size_t lastMarker = 0;
+    size_t i = 0;
+    do {
+        lastMarker = out.size();
+        out.push_back(0);
+
+        bool     runBit = false;
+        uint64_t run    = 0;
+        if (i < count && (words[i] == 0 || words[i] == ALL_ONES)) {
+            const uint64_t fill = words[i];
+            runBit = fill != 0;
+            while (i < count && words[i] == fill && run < MAX_RUN) { ++i; ++run; }
+        }
+        uint64_t literals = 0;
+        while (i < count && words[i] != 0 && words[i] != ALL_ONES && literals < MAX_LITERALS) {
+            out.push_back(words[i++]);
+            ++literals;
+        }
+        out[lastMarker] = markerWord(runBit, run, literals);
+    } while (i < count);
+
+    std::string data;
+    data.reserve(12 + out.size() * 8);
+    appendBE32(data, bitCount);
+    appendBE32(data, static_cast<uint32_t>(out.size()));
+    for (uint64_t w : out) appendBE64(data, w);
+    appendBE32(data, static_cast<uint32_t>(lastMarker));
+    return data;
+}
+
+size_t ewahOrInto(std::string_view data, std::vector<uint64_t>& words)
+{
+    const auto* p   = reinterpret_cast<const unsigned char*>(data.data());
+    const size_t size = data.size();
+    if (size < 8) return 0;
+
+    const uint32_t bitCount  = readBE32(p);
+    const uint32_t wordCount = readBE32(p + 4);
+    const size_t   total     = 8 + size_t(wordCount) * 8 + 4;
+    if (total > size) return 0;
+
+    const size_t plainWords = (size_t(bitCount) + 63) / 64;
+    if (words.size() < plainWords) words.resize(plainWords, 0);
+
+    const unsigned char* w   = p + 8;
+    size_t               pos = 0;   // in `words`
+    for (uint32_t i = 0; i < wordCount;) {
+        const uint64_t marker   = readBE64(w + size_t(i) * 8);
+        const uint64_t run      = (marker >> 1) & MAX_RUN;
+        const uint64_t literals = marker >> 33;
+        ++i;
+        if (run > plainWords - pos || literals > plainWords - pos - run ||
+            literals > wordCount - i)
+            return 0;
+
+        if (marker & 1)
+            for (uint64_t k = 0; k < run; ++k) words[pos + k] = ALL_ONES;
+        pos += run;
+        for (uint64_t k = 0; k < literals; ++k, ++i) words[pos++] |= readBE64(w + size_t(i) * 8);
+    }
+    return total;
+}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vit::storage {
+
+// EWAH-compressed bitmaps, serialised as git does in .bitmap files: the
+// bit count and word count as 32-bit big-endian values, the 64-bit words,
+// then the position of the last marker word. Each marker word holds a run
+// of identical all-zero or all-one words (bit 0 says which, bits 1..32 the
+// run length) and the number of literal words that follow it (bits 33..63).
+
+// Compresses the plain bitmap `words`, of which the first `bitCount` bits
+// are meaningful.
+std::string ewahEncode(const std::vector<uint64_t>& words, uint32_t bitCount);
+
+// ORs the bitmap serialised at the start of `data` into `words`, which is
+// grown to fit. Returns the number of bytes it took up, or 0 if malformed.
+size_t ewahOrInto(std::string_view data, std::vector<uint64_t>& words);
+
+}
@@ -0,0 +1,242 @@
+#include "gc.hpp"
+#include "bitmap_index.hpp"
+#include "commit_graph.hpp"
+#include "commit_view.hpp"
+#include "compression.hpp"
+#include "index_file.hpp"
+#include "known_objects.hpp"
+#include "object_store.hpp"
+#include "pack.hpp"
+#include "tree_view.hpp"
+#include "zstd_codec.hpp"
+#include "../commit.hpp"
+#include "../utils/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <filesystem>
+#include <set>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace vit::storage {
+
+bool ReachableObjects::insert(const ObjectId& id)
+{
+    Shard& s = shard(id);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.ids.insert(id).second;
+}
+
+bool ReachableObjects::contains(const ObjectId& id) const
+{
+    const Shard& s = shard(id);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.ids.count(id) != 0;
+}
+
+size_t ReachableObjects::size() const
+{
+    size_t total = 0;
+    for (const auto& s : shards_) {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        total += s.ids.size();
+    }
+    return total;
+}
+
+namespace {
+
+class Marker {
+public:
+    explicit Marker(ReachableObjects& out) : out_(out) {}
+
+    bool run(const std::vector<ObjectId>& tips, const std::vector<ObjectId>& trees)
+    {
+        constexpr size_t BATCH = 256;
+
+        for (const auto& tree : trees) {
+            if (out_.insert(tree)) pool_.submit([this, tree] { markTree(tree); });
+        }
+
+        const std::vector<ObjectId> commits = getReachableCommits(tips);
+        for (const auto& commit : commits) out_.insert(commit);
+
+        // commits missing from the graph are inflated for their tree, so
+        // those are spread over the pool too
+        for (size_t begin = 0; begin < commits.size(); begin += BATCH) {
+            pool_.submit([this, &commits, begin] {
+                const size_t end = std::min(begin + BATCH, commits.size());
+                for (size_t i = begin; i < end; ++i) markCommit(commits[i]);
+            });
+        }
+        pool_.wait();
+        return !failed_;
+    }
+
+private:
+    void markCommit(const ObjectId& commit)
+    {
+        const auto& graph = CommitGraph::instance();
+        uint32_t pos;
+        const ObjectId tree = graph.lookup(commit, pos) ? graph.treeAt(pos) : CommitView(commit).tree();
+        if (tree.isNull()) {
+            failed_ = true;
+            return;
+        }
+        if (out_.insert(tree)) markTree(tree);
+    }
+
+    // `tree` is already marked; its entries are marked here and new
+    // subtrees handed to the pool.
+    void markTree(const ObjectId& tree)
+    {
+        const TreeView view(tree);
+        if (!view.valid()) {
+            failed_ = true;
+            return;
+        }
+        for (const auto& e : view) {
+            if (e.mode == TreeMode::Gitlink) continue;   // a commit in another repository
+            if (!out_.insert(e.id) || !e.isDirectory()) continue;
+            const ObjectId child = e.id;
+            pool_.submit([this, child] { markTree(child); });
+        }
+    }
+
+    ReachableObjects&      out_;
+    vit::utils::ThreadPool pool_;
+    std::atomic<bool>      failed_{false};
+};
+
+} // namespace
+
+bool markReachable(const std::vector<ObjectId>& tips, ReachableObjects& out,
+                   const std::vector<ObjectId>& trees)
+{
+    return Marker(out).run(tips, trees);
+}
+
+namespace {
+
+// Cached trees that are still in the store; the index may name trees a
+// previous gc deleted, which writeTree checks for before reusing them.
+void collectCachedTrees(const CacheTree& node, std::vector<ObjectId>& out)
+{
+    if (node.entryCount >= 0 && KnownObjects::instance().contains(node.id)) out.push_back(node.id);
+    for (const auto& child : node.children) collectCachedTrees(child, out);
+}
+
+// The dictionary is trained on small objects only, which are the ones it
+// helps; a few thousand of them say all there is to say about tree and
+// commit layout.
+constexpr size_t DICTIONARY_SAMPLE_LIMIT = 16 * 1024;
+constexpr size_t MIN_DICTIONARY_SAMPLES  = 256;
+constexpr size_t MAX_DICTIONARY_SAMPLES  = 4096;
+
+void trainDictionary(const std::vector<ObjectId>& ids, GcResult& result)
+{
+    std::vector<std::string> samples;
+    for (const auto& id : ids) {
+        if (samples.size() == MAX_DICTIONARY_SAMPLES) break;
+        ObjectType  type;
+        uint64_t    size;
+        std::string content;
+        if (!peekObjectHeader(id, type, size) || size > DICTIONARY_SAMPLE_LIMIT ||
+            !loadObject(id, type, content))
+            continue;
+        // compressed objects include their header, so the samples do too
+        samples.push_back(std::string(typeName(type)) + ' ' + std::to_string(size) + '\0' + content);
+    }
+    // too few to learn from; a later gc tries again
+    if (samples.size() < MIN_DICTIONARY_SAMPLES) return;
+    if (trainZstdDictionary(samples, &result.dictionaryError)) result.dictionarySamples = samples.size();
+}
+
+}
+
+bool countReachable(const std::vector<ObjectId>& tips, size_t& count)
+{
+    const BitmapIndex& bitmaps = BitmapIndex::instance();
+    if (bitmaps.valid()) {
+        Reachability reachable;
+        if (!bitmaps.reachable(tips, {}, reachable)) return false;
+        count = reachable.count();
+        return true;
+    }
+
+    ReachableObjects reachable;
+    if (!markReachable(tips, reachable)) return false;
+    count = reachable.size();
+    return true;
+}
+
+GcResult collectGarbage(const GcOptions& options)
+{
+    GcResult result;
+
+    IndexFile index;
+    index.load();
+    std::vector<ObjectId> cachedTrees;
+    if (const CacheTree* tree = index.cacheTree()) collectCachedTrees(*tree, cachedTrees);
+
+    // the bitmaps replace most of the walk; without them every tree is read
+    const BitmapIndex& bitmaps = BitmapIndex::instance();
+    result.usedBitmaps = bitmaps.valid();
+    Reachability     fromBitmaps;
+    ReachableObjects walked;
+    bool marked;
+    if (result.usedBitmaps) {
+        marked = bitmaps.reachable(collectReferenceCommits(), cachedTrees, fromBitmaps);
+        for (const auto& e : index.entries()) fromBitmaps.mark(e.id);
+    } else {
+        for (const auto& e : index.entries()) walked.insert(e.id);
+        marked = markReachable(collectReferenceCommits(), walked, cachedTrees);
+    }
+    if (!marked) {
+        result.error = "some reachable objects are missing; nothing was deleted";
+        return result;
+    }
+    auto isReachable = [&](const ObjectId& id) {
+        return result.usedBitmaps ? fromBitmaps.contains(id) : walked.contains(id);
+    };
+    result.reachable = result.usedBitmaps ? fromBitmaps.count() : walked.size();
+
+    const bool train = objectCodec() == ObjectCodec::Zstd && !hasZstdDictionary();
+    std::vector<ObjectId> survivors;   // dictionary samples
+
+    const int64_t cutoff = static_cast<int64_t>(std::time(nullptr)) - options.gracePeriod;
+    std::set<std::string> touchedDirs;
+    for (const auto& id : listLooseObjects()) {
+        if (isReachable(id)) {
+            if (train) survivors.push_back(id);
+            continue;
+        }
+
+        const std::string path = getObjectPath(id);
+        struct stat st{};
+        if (::stat(path.c_str(), &st) != 0) continue;
+        if (static_cast<int64_t>(st.st_mtime) > cutoff) {
+            ++result.kept;
+            continue;
+        }
+        if (::unlink(path.c_str()) != 0) continue;
+        ++result.pruned;
+        result.bytesFreed += static_cast<uint64_t>(st.st_size);
+        touchedDirs.insert(std::filesystem::path(path).parent_path().string());
+    }
+
+    // fan-out directories left empty go too; others fail to be removed
+    std::error_code ec;
+    for (const auto& dir : touchedDirs) std::filesystem::remove(dir, ec);
+
+    if (train) trainDictionary(survivors, result);
+
+    KnownObjects::instance().reset();
+    result.success = true;
+    return result;
+}
+
+}
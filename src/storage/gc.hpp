@@ -0,0 +1,76 @@
+#pragma once
+#include "object_id.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace vit::storage {
+
+// Set of object names that many threads add to at once while marking.
+// Names are spread over independently locked shards by their first byte.
+class ReachableObjects {
+public:
+    // True if `id` was not marked before.
+    bool   insert(const ObjectId& id);
+    bool   contains(const ObjectId& id) const;
+    size_t size() const;
+
+private:
+    struct Shard {
+        mutable std::mutex           mutex;
+        std::unordered_set<ObjectId> ids;
+    };
+
+    Shard&       shard(const ObjectId& id)       { return shards_[id.data()[0] % shards_.size()]; }
+    const Shard& shard(const ObjectId& id) const { return shards_[id.data()[0] % shards_.size()]; }
+
+    std::array<Shard, 64> shards_;
+};
+
+// Marks every commit reachable from `tips`, and every tree and blob those
+// commits point to. Commits come from the history walk (through the
+// commit-graph where it has them); their trees are read on the worker
+// pool, and a tree shared by many commits is read only once. Returns false
+// if some reachable commit or tree could not be read, in which case the
+// marks are incomplete and must not be used to delete anything. `trees`
+// are marked, with everything below them, as well.
+bool markReachable(const std::vector<ObjectId>& tips, ReachableObjects& out,
+                   const std::vector<ObjectId>& trees = {});
+
+// Number of objects reachable from `tips`, through the reachability
+// bitmaps (storage/bitmap_index.hpp) when a pack has them.
+bool countReachable(const std::vector<ObjectId>& tips, size_t& count);
+
+struct GcOptions {
+    // Unreachable loose objects modified less than this many seconds ago
+    // are kept, so that objects written by a command still running (whose
+    // commit is not referenced yet) survive.
+    int64_t gracePeriod = 14 * 24 * 60 * 60;
+};
+
+struct GcResult {
+    bool        success = false;
+    size_t      reachable = 0;
+    size_t      pruned = 0;        // unreachable loose objects deleted
+    size_t      kept = 0;          // unreachable, but inside the grace period
+    bool        usedBitmaps = false;
+    uint64_t    bytesFreed = 0;
+    size_t      dictionarySamples = 0;   // objects a new zstd dictionary was trained on
+    std::string dictionaryError;         // why training one failed, if it did
+    std::string error;
+};
+
+// Marks from every ref and HEAD, and from the blobs and cached trees in
+// .git/index as git does, then deletes the unreachable loose objects older
+// than the grace period. Packed objects are left alone. With reachability
+// bitmaps, marking only walks the history they do not cover. In a zstd
+// repository without a dictionary yet, one is trained on the small loose
+// objects that remain (storage/zstd_codec.hpp).
+GcResult collectGarbage(const GcOptions& options = {});
+
+}
@@ -0,0 +1,333 @@
+#include "index_file.hpp"
+#include "mapped_file.hpp"
+#include "sha1.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace vit::storage {
+
+namespace {
+
+constexpr uint32_t INDEX_SIGNATURE = 0x44495243;   // "DIRC"
+constexpr uint32_t INDEX_VERSION   = 2;
+constexpr size_t   ENTRY_FIXED     = 62;           // stat fields, name and flags
+constexpr uint16_t NAME_MASK       = 0x0fff;
+constexpr uint32_t CACHE_TREE_SIG  = 0x56545245;   // "VTRE"
+
+uint32_t readBE32(const unsigned char* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+void appendBE32(std::string& out, uint32_t v)
+{
+    out += static_cast<char>(v >> 24);
+    out += static_cast<char>(v >> 16);
+    out += static_cast<char>(v >> 8);
+    out += static_cast<char>(v);
+}
+
+// Entries are padded with 1-8 NULs to a multiple of eight bytes.
+size_t entrySize(size_t nameLength)
+{
+    return (ENTRY_FIXED + nameLength + 8) & ~size_t(7);
+}
+
+bool writeAll(int fd, const std::string& data)
+{
+    const char* p    = data.data();
+    size_t      left = data.size();
+    while (left) {
+        const ssize_t n = ::write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p    += n;
+        left -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Pre-order: "<name>\0<entries> <subtrees>\n", the tree name if valid,
+// then each subtree the same way.
+bool parseCacheTree(const unsigned char*& p, const unsigned char* end, CacheTree& node, int depth)
+{
+    const void* nul = std::memchr(p, '\0', end - p);
+    if (!nul || depth > 4096) return false;
+    node.name.assign(reinterpret_cast<const char*>(p), static_cast<const unsigned char*>(nul) - p);
+    p = static_cast<const unsigned char*>(nul) + 1;
+
+    const char* q    = reinterpret_cast<const char*>(p);
+    const char* qend = reinterpret_cast<const char*>(end);
+    size_t subtrees = 0;
+    auto r = std::from_chars(q, qend, node.entryCount);
+    if (r.ec != std::errc() || r.ptr == qend || *r.ptr != ' ') return false;
+    r = std::from_chars(r.ptr + 1, qend, subtrees);
+    if (r.ec != std::errc() || r.ptr == qend || *r.ptr != '\n') return false;
+    p = reinterpret_cast<const unsigned char*>(r.ptr + 1);
+
+    if (node.entryCount >= 0) {
+        if (static_cast<size_t>(end - p) < ObjectId::RAW_SIZE) return false;
+        node.id = ObjectId::fromRaw(p);
+        p += ObjectId::RAW_SIZE;
+    }
+    if (subtrees > static_cast<size_t>(end - p)) return false;
+    node.children.resize(subtrees);
+    for (auto& child : node.children)
+        if (!parseCacheTree(p, end, child, depth + 1)) return false;
+    return true;
+}
+
+void writeCacheTree(std::string& out, const CacheTree& node)
+{
+    out += node.name;
+    out += '\0';
+    out += std::to_string(node.entryCount) + ' ' + std::to_string(node.children.size()) + '\n';
+    if (node.entryCount >= 0) out += node.id.raw();
+    for (const auto& child : node.children) writeCacheTree(out, child);
+}
+
+} // namespace
+
+const CacheTree* CacheTree::child(const std::string& childName) const
+{
+    const auto it = std::lower_bound(children.begin(), children.end(), childName,
+                                     [](const CacheTree& c, const std::string& n){ return c.name < n; });
+    return it != children.end() && it->name == childName ? &*it : nullptr;
+}
+
+IndexEntry IndexEntry::fromStat(const std::string& path, const struct stat& st, const ObjectId& id)
+{
+    IndexEntry e;
+    e.path      = path;
+    e.ctimeSec  = static_cast<uint32_t>(st.st_ctim.tv_sec);
+    e.ctimeNsec = static_cast<uint32_t>(st.st_ctim.tv_nsec);
+    e.mtimeSec  = static_cast<uint32_t>(st.st_mtim.tv_sec);
+    e.mtimeNsec = static_cast<uint32_t>(st.st_mtim.tv_nsec);
+    e.dev       = static_cast<uint32_t>(st.st_dev);
+    e.ino       = static_cast<uint32_t>(st.st_ino);
+    e.mode      = 0100644;   // vit records every file as a plain blob
+    e.uid       = static_cast<uint32_t>(st.st_uid);
+    e.gid       = static_cast<uint32_t>(st.st_gid);
+    e.size      = static_cast<uint32_t>(st.st_size);
+    e.id        = id;
+    return e;
+}
+
+bool IndexFile::load(const std::string& path)
+{
+    entries_.clear();
+    cacheTree_ = CacheTree();
+    sorted_ = true;
+
+    MappedFile map;
+    if (!map.open(path)) return true;   // no index yet
+
+    struct stat st{};
+    if (::stat(path.c_str(), &st) == 0) {
+        stampSec_  = static_cast<uint32_t>(st.st_mtim.tv_sec);
+        stampNsec_ = static_cast<uint32_t>(st.st_mtim.tv_nsec);
+    }
+
+    auto corrupt = [&](const char* why) {
+        std::cerr << "Ignoring " << path << ": " << why << '\n';
+        entries_.clear();
+        return false;
+    };
+
+    const unsigned char* data = map.data();
+    const size_t         size = map.size();
+    if (size < 12 + ObjectId::RAW_SIZE) return corrupt("too short");
+    if (readBE32(data) != INDEX_SIGNATURE) return corrupt("bad signature");
+    if (readBE32(data + 4) != INDEX_VERSION) return corrupt("unsupported version");
+
+    if (hashBytes(data, size - ObjectId::RAW_SIZE) != ObjectId::fromRaw(data + size - ObjectId::RAW_SIZE))
+        return corrupt("checksum mismatch");
+
+    const uint32_t count = readBE32(data + 8);
+    const size_t   end   = size - ObjectId::RAW_SIZE;
+    size_t         pos   = 12;
+    entries_.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (pos + ENTRY_FIXED > end) return corrupt("truncated entry");
+        const unsigned char* p = data + pos;
+
+        IndexEntry e;
+        e.ctimeSec  = readBE32(p);
+        e.ctimeNsec = readBE32(p + 4);
+        e.mtimeSec  = readBE32(p + 8);
+        e.mtimeNsec = readBE32(p + 12);
+        e.dev       = readBE32(p + 16);
+        e.ino       = readBE32(p + 20);
+        e.mode      = readBE32(p + 24);
+        e.uid       = readBE32(p + 28);
+        e.gid       = readBE32(p + 32);
+        e.size      = readBE32(p + 36);
+        e.id        = ObjectId::fromRaw(p + 40);
+
+        const uint16_t flags = static_cast<uint16_t>((p[60] << 8) | p[61]);
+        if (flags & 0x4000) return corrupt("extended flags in a version 2 index");
+
+        // names of 0xfff bytes or more are only NUL-terminated
+        const char* name = reinterpret_cast<const char*>(p + ENTRY_FIXED);
+        const void* nul  = std::memchr(name, '\0', end - pos - ENTRY_FIXED);
+        if (!nul) return corrupt("unterminated path");
+        const size_t nameLength = static_cast<const char*>(nul) - name;
+        if ((flags & NAME_MASK) != std::min<size_t>(nameLength, NAME_MASK))
+            return corrupt("path length mismatch");
+        pos += entrySize(nameLength);
+        if (pos > end) return corrupt("truncated entry");
+        if ((flags >> 12) & 0x3) continue;   // merge stages are not ours to reuse
+
+        e.path.assign(name, nameLength);
+        entries_.push_back(std::move(e));
+    }
+
+    // extensions: signature, size, data; only our cache tree is of interest
+    while (pos + 8 <= end) {
+        const uint32_t sig     = readBE32(data + pos);
+        const uint32_t extSize = readBE32(data + pos + 4);
+        pos += 8;
+        if (extSize > end - pos) return corrupt("truncated extension");
+        if (sig == CACHE_TREE_SIG) {
+            const unsigned char* p = data + pos;
+            if (!parseCacheTree(p, data + pos + extSize, cacheTree_, 0)) {
+                std::cerr << "Ignoring damaged tree cache in " << path << '\n';
+                cacheTree_ = CacheTree();
+            }
+        }
+        pos += extSize;
+    }
+    return true;
+}
+
+const IndexEntry* IndexFile::find(const std::string& path) const
+{
+    const auto it = std::lower_bound(entries_.begin(), entries_.end(), path,
+                                     [](const IndexEntry& e, const std::string& p){ return e.path < p; });
+    return it != entries_.end() && it->path == path ? &*it : nullptr;
+}
+
+const IndexEntry* IndexFile::lookupClean(const std::string& path, const struct stat& st) const
+{
+    const IndexEntry* e = find(path);
+    if (!e) return nullptr;
+
+    const IndexEntry now = IndexEntry::fromStat(path, st, {});
+    if (e->mtimeSec != now.mtimeSec || e->mtimeNsec != now.mtimeNsec ||
+        e->ctimeSec != now.ctimeSec || e->ctimeNsec != now.ctimeNsec ||
+        e->ino != now.ino || e->size != now.size || !S_ISREG(st.st_mode))
+        return nullptr;
+
+    // racily clean: written no earlier than the index, so an edit made
+    // later in the same timestamp tick would leave the stat data unchanged
+    if (e->mtimeSec > stampSec_ || (e->mtimeSec == stampSec_ && e->mtimeNsec >= stampNsec_))
+        return nullptr;
+    return e;
+}
+
+void IndexFile::add(IndexEntry entry)
+{
+    if (!entries_.empty() && !(entries_.back().path < entry.path)) sorted_ = false;
+    entries_.push_back(std::move(entry));
+}
+
+// Recorded as an entry with the null id, so that the latest add or remove
+// of a path wins when the entries are sorted.
+void IndexFile::remove(const std::string& path)
+{
+    IndexEntry tombstone;
+    tombstone.path = path;
+    entries_.push_back(std::move(tombstone));
+    sorted_ = false;
+}
+
+void IndexFile::invalidatePath(std::string_view path)
+{
+    CacheTree* node = &cacheTree_;
+    node->entryCount = -1;
+    for (size_t slash; (slash = path.find('/')) != std::string_view::npos; path.remove_prefix(slash + 1)) {
+        const std::string_view name = path.substr(0, slash);
+        const auto it = std::lower_bound(node->children.begin(), node->children.end(), name,
+                                         [](const CacheTree& c, std::string_view n){ return c.name < n; });
+        if (it == node->children.end() || it->name != name) return;
+        node = &*it;
+        node->entryCount = -1;
+    }
+}
+
+void IndexFile::sort()
+{
+    if (sorted_) return;
+    std::stable_sort(entries_.begin(), entries_.end(),
+                     [](const IndexEntry& a, const IndexEntry& b){ return a.path < b.path; });
+    // a path added twice keeps its latest entry
+    std::vector<IndexEntry> unique;
+    unique.reserve(entries_.size());
+    for (auto& e : entries_) {
+        if (!unique.empty() && unique.back().path == e.path) unique.back() = std::move(e);
+        else                                                 unique.push_back(std::move(e));
+    }
+    std::erase_if(unique, [](const IndexEntry& e) { return e.id.isNull(); });
+    entries_.swap(unique);
+    sorted_ = true;
+}
+
+bool IndexFile::write(const std::string& path)
+{
+    sort();
+
+    std::string out;
+    out.reserve(12 + entries_.size() * 96 + ObjectId::RAW_SIZE);
+    appendBE32(out, INDEX_SIGNATURE);
+    appendBE32(out, INDEX_VERSION);
+    appendBE32(out, static_cast<uint32_t>(entries_.size()));
+
+    for (const auto& e : entries_) {
+        const size_t start = out.size();
+        for (uint32_t v : {e.ctimeSec, e.ctimeNsec, e.mtimeSec, e.mtimeNsec, e.dev, e.ino,
+                           e.mode, e.uid, e.gid, e.size})
+            appendBE32(out, v);
+        out += e.id.raw();
+        const uint16_t flags = static_cast<uint16_t>(std::min<size_t>(e.path.size(), NAME_MASK));
+        out += static_cast<char>(flags >> 8);
+        out += static_cast<char>(flags);
+        out += e.path;
+        out.append(entrySize(e.path.size()) - (out.size() - start), '\0');
+    }
+
+    if (cacheTree()) {
+        std::string ext;
+        writeCacheTree(ext, cacheTree_);
+        appendBE32(out, CACHE_TREE_SIG);
+        appendBE32(out, static_cast<uint32_t>(ext.size()));
+        out += ext;
+    }
+
+    out += hashBytes(out.data(), out.size()).raw();
+
+    // same lock protocol as git: whoever creates index.lock owns the update
+    const std::string lockPath = path + ".lock";
+    const int fd = ::open(lockPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Could not lock " << path << "; leaving it unchanged\n";
+        return false;
+    }
+    const bool ok = writeAll(fd, out);
+    if (::close(fd) != 0 || !ok || ::rename(lockPath.c_str(), path.c_str()) != 0) {
+        ::unlink(lockPath.c_str());
+        std::cerr << "Failed to write " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+}
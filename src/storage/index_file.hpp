@@ -0,0 +1,94 @@
+#pragma once
+#include "object_id.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct stat;
+
+namespace vit::storage {
+
+// One tracked file: the stat data it had when its blob was last hashed or
+// checked out, and that blob's name.
+struct IndexEntry {
+    std::string path;        // relative to the work tree, '/'-separated
+    uint32_t    ctimeSec  = 0;
+    uint32_t    ctimeNsec = 0;
+    uint32_t    mtimeSec  = 0;
+    uint32_t    mtimeNsec = 0;
+    uint32_t    dev  = 0;
+    uint32_t    ino  = 0;
+    uint32_t    mode = 0100644;
+    uint32_t    uid  = 0;
+    uint32_t    gid  = 0;
+    uint32_t    size = 0;    // truncated to 32 bits, as in git
+    ObjectId    id;
+
+    static IndexEntry fromStat(const std::string& path, const struct stat& st, const ObjectId& id);
+};
+
+// Tree written for one directory the last time the whole work tree was
+// written: how many files it covered (recursively) and its subtrees, sorted
+// by name. A directory whose files and subtrees all come out as recorded
+// can reuse `id` without building its tree object again.
+struct CacheTree {
+    std::string            name;              // path component, empty at the root
+    int64_t                entryCount = -1;   // -1 when invalid
+    ObjectId               id;
+    std::vector<CacheTree> children;
+
+    const CacheTree* child(const std::string& childName) const;
+};
+
+// Stat cache over the work tree, stored as a git DIRC version 2 index in
+// .git/index. A file whose stat data still matches its entry can reuse the
+// recorded blob name instead of being read and hashed again.
+class IndexFile {
+public:
+    // A missing index loads as empty. A corrupt one is reported and
+    // ignored, since everything in it can be recomputed.
+    bool load(const std::string& path = ".git/index");
+
+    // Sorts the entries and replaces the index through .git/index.lock.
+    bool write(const std::string& path = ".git/index");
+
+    const IndexEntry* find(const std::string& path) const;
+
+    // The recorded blob for `path` if `st` still matches its entry and the
+    // entry is not racily clean (modified in the same instant the index
+    // was written, so a later same-size edit would go unnoticed).
+    const IndexEntry* lookupClean(const std::string& path, const struct stat& st) const;
+
+    void add(IndexEntry entry);
+    void remove(const std::string& path);   // applied, like add, in path order
+    void clear() { entries_.clear(); sorted_ = true; }
+
+    const std::vector<IndexEntry>& entries() const { return entries_; }
+
+    // Stored in an optional "VTRE" extension laid out like git's TREE. It is
+    // deliberately not TREE: vit keeps empty directories and sorts tree
+    // entries by plain name, so git must not take these trees as its own.
+    // The root may be invalid while trees below it are still usable.
+    const CacheTree* cacheTree() const
+    {
+        return cacheTree_.entryCount >= 0 || !cacheTree_.children.empty() ? &cacheTree_ : nullptr;
+    }
+    void             setCacheTree(CacheTree tree) { cacheTree_ = std::move(tree); }
+
+    // Marks the cached trees of every directory containing `path`,
+    // including the root, as invalid; their subtrees stay usable.
+    void             invalidatePath(std::string_view path);
+
+private:
+    void sort();
+
+    std::vector<IndexEntry> entries_;
+    CacheTree               cacheTree_;
+    bool                    sorted_    = true;
+    uint32_t                stampSec_  = 0;   // mtime of the loaded index file
+    uint32_t                stampNsec_ = 0;
+};
+
+}
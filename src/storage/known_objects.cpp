@@ -0,0 +1,109 @@
+#include "known_objects.hpp"
+#include "pack.hpp"
+
+#include <cstdio>
+#include <filesystem>
+
+namespace vit::storage {
+
+KnownObjects& KnownObjects::instance()
+{
+    static KnownObjects known;
+    return known;
+}
+
+void KnownObjects::load(Bucket& bucket, unsigned char prefix)
+{
+    bucket.loaded = true;
+
+    char dirName[3];
+    std::snprintf(dirName, sizeof(dirName), "%02x", prefix);
+    const std::filesystem::path dir = std::filesystem::path(".git/objects") / dirName;
+
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        const ObjectId id = ObjectId::fromHex(dirName + it->path().filename().string());
+        if (!id.isNull()) bucket.names.insert(id);
+    }
+}
+
+bool KnownObjects::contains(const ObjectId& id)
+{
+    const unsigned char prefix = id.bytes[0];
+    Bucket& bucket = buckets_[prefix];
+    {
+        std::lock_guard<std::mutex> lock(bucket.mutex);
+        if (!bucket.loaded) load(bucket, prefix);
+        if (bucket.names.count(id)) return true;
+    }
+    return PackStore::instance().contains(id);
+}
+
+bool KnownObjects::claim(const ObjectId& id)
+{
+    const unsigned char prefix = id.bytes[0];
+    Bucket& bucket = buckets_[prefix];
+    auto unclaimed = [&] { return !bucket.claimed.count(id); };
+    {
+        std::unique_lock<std::mutex> lock(bucket.mutex);
+        if (!bucket.loaded) load(bucket, prefix);
+        bucket.settled.wait(lock, unclaimed);
+        if (bucket.names.count(id)) {
+            elided_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    if (PackStore::instance().contains(id)) {
+        elided_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // another writer may have claimed it while the packs were asked
+    std::unique_lock<std::mutex> lock(bucket.mutex);
+    bucket.settled.wait(lock, unclaimed);
+    if (bucket.names.count(id)) {
+        elided_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    bucket.claimed.insert(id);
+    written_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void KnownObjects::stored(const ObjectId& id)
+{
+    Bucket& bucket = buckets_[id.bytes[0]];
+    {
+        std::lock_guard<std::mutex> lock(bucket.mutex);
+        bucket.claimed.erase(id);
+        bucket.names.insert(id);
+    }
+    bucket.settled.notify_all();
+}
+
+void KnownObjects::forget(const ObjectId& id)
+{
+    Bucket& bucket = buckets_[id.bytes[0]];
+    {
+        std::lock_guard<std::mutex> lock(bucket.mutex);
+        if (bucket.claimed.erase(id)) written_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    bucket.settled.notify_all();
+}
+
+void KnownObjects::reset()
+{
+    for (Bucket& bucket : buckets_) {
+        std::lock_guard<std::mutex> lock(bucket.mutex);
+        bucket.loaded = false;
+        bucket.names.clear();
+    }
+}
+
+KnownObjects::Stats KnownObjects::stats() const
+{
+    return Stats{written_.load(std::memory_order_relaxed), elided_.load(std::memory_order_relaxed)};
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "object_id.hpp"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+namespace vit::storage {
+
+// Names of the objects already in the store, so that writers can skip
+// deflating and writing content that is there already. Loose names are
+// read one fan-out directory at a time, the first time a name with that
+// prefix is asked about; packed objects are answered by the pack indexes.
+class KnownObjects {
+public:
+    struct Stats {
+        uint64_t written = 0;
+        uint64_t elided  = 0;
+    };
+
+    static KnownObjects& instance();
+
+    bool contains(const ObjectId& id);
+
+    // Claims `id` for writing. Returns false, and counts an elided
+    // write, if the object already exists. While another writer holds a
+    // claim on `id`, waits for it to settle: false once that write is
+    // stored, or the claim passes to this caller if it failed, so a
+    // failed write is never taken for a stored object.
+    bool claim(const ObjectId& id);
+
+    // Settles a claim: the object is in the store now.
+    void stored(const ObjectId& id);
+
+    // Settles a claim whose write failed.
+    void forget(const ObjectId& id);
+
+    // Drops everything learned so far; call after objects are deleted.
+    void reset();
+
+    Stats stats() const;
+
+private:
+    struct Bucket {
+        std::mutex                      mutex;
+        std::condition_variable         settled;
+        bool                            loaded = false;
+        std::unordered_set<ObjectId>    names;
+        std::unordered_set<ObjectId>    claimed;   // being written
+    };
+
+    KnownObjects() = default;
+    void load(Bucket& bucket, unsigned char prefix);
+
+    std::array<Bucket, 256> buckets_;
+    std::atomic<uint64_t>   written_{0};
+    std::atomic<uint64_t>   elided_{0};
+};
+
+}
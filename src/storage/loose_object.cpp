@@ -0,0 +1,602 @@
+#include "loose_object.hpp"
+#include "compression.hpp"
+#include "known_objects.hpp"
+#include "mapped_file.hpp"
+#include "sha1.hpp"
+#include "zstd_codec.hpp"
+#include "../commit.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+namespace vit::storage {
+
+namespace {
+
+// zlib counts input in 32-bit units, so very large mappings go in slices.
+void feedInput(z_stream& strm, const unsigned char*& next, const unsigned char* end,
+               size_t slice = 1u << 30)
+{
+    if (strm.avail_in != 0 || next == end) return;
+    const size_t chunk = std::min<size_t>(end - next, slice);
+    strm.next_in  = const_cast<Bytef*>(next);
+    strm.avail_in = static_cast<uInt>(chunk);
+    next += chunk;
+}
+
+constexpr size_t STREAM_CHUNK       = 128 * 1024;
+constexpr size_t STREAM_INPUT_SLICE = 1024 * 1024;
+constexpr size_t SMALL_BLOB_LIMIT   = 1024 * 1024;
+constexpr size_t BATCH_BLOB_LIMIT   = 64 * 1024;
+constexpr size_t STREAM_SAMPLE      = 16 * 1024;
+
+bool writeAll(int fd, const unsigned char* data, size_t size)
+{
+    while (size) {
+        const ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Deflates `size` bytes into `fd`, draining the output buffer as it fills.
+bool deflateTo(z_stream& strm, int fd, const unsigned char* data, size_t size, int flush)
+{
+    unsigned char out[STREAM_CHUNK];
+    strm.next_in  = const_cast<Bytef*>(data);
+    strm.avail_in = static_cast<uInt>(size);
+    do {
+        strm.next_out  = out;
+        strm.avail_out = sizeof(out);
+        const int ret = deflate(&strm, flush);
+        if (ret == Z_STREAM_ERROR) return false;
+        if (!writeAll(fd, out, sizeof(out) - strm.avail_out)) return false;
+    } while (strm.avail_out == 0);
+    return true;
+}
+
+// SHA-1 of "blob <size>\0" followed by the file, read from its start.
+bool hashBlobFile(int fd, uint64_t size, ObjectId& id)
+{
+    Sha1 sha;
+    sha.update("blob " + std::to_string(size) + '\0');
+
+    static thread_local unsigned char buf[STREAM_CHUNK];
+    uint64_t total = 0;
+    bool     ok    = ::lseek(fd, 0, SEEK_SET) == 0;
+    while (ok) {
+        const ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            ok = n == 0;
+            break;
+        }
+        total += static_cast<uint64_t>(n);
+        sha.update(buf, static_cast<size_t>(n));
+    }
+    id = sha.finish();
+    return ok && total == size && ::lseek(fd, 0, SEEK_SET) == 0;
+}
+
+// Reads the `size` bytes of the file open at `fd` into `content`.
+bool readWhole(int fd, uint64_t size, std::string& content)
+{
+    content.resize(size);
+    size_t got = 0;
+    while (got < size) {
+        const ssize_t n = ::read(fd, content.data() + got, size - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += static_cast<size_t>(n);
+    }
+    return got == size;
+}
+
+// Parses "<type> <size>\0" from the first `produced` decompressed bytes.
+bool parseHeader(const std::string& path, const char (&head)[64], size_t produced,
+                 ObjectType& type, uint64_t& size, size_t& headerEnd)
+{
+    const char* nul = static_cast<const char*>(std::memchr(head, '\0', produced));
+    const char* sp  = static_cast<const char*>(std::memchr(head, ' ', produced));
+    if (!nul || !sp || sp > nul ||
+        std::from_chars(sp + 1, nul, size).ec != std::errc() ||
+        (type = typeFromName(std::string(head, sp - head))) == ObjectType::None) {
+        std::cerr << "Corrupt object header: " << path << '\n';
+        return false;
+    }
+    headerEnd = nul + 1 - head;
+    if (produced - headerEnd > size) {
+        std::cerr << "Object larger than its header says: " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+// Inflates just enough of a loose object to parse "<type> <size>\0".
+// Bytes of content that came out along with the header are left in
+// head[headerEnd, produced).
+bool inflateHeader(z_stream& strm, const unsigned char*& next, const unsigned char* end,
+                   const std::string& path, char (&head)[64], ObjectType& type, uint64_t& size,
+                   size_t& headerEnd, size_t& produced)
+{
+    strm.next_out  = reinterpret_cast<Bytef*>(head);
+    strm.avail_out = sizeof(head);
+    int ret = Z_OK;
+    while (strm.avail_out > 0 && ret == Z_OK) {
+        feedInput(strm, next, end, STREAM_INPUT_SLICE);
+        ret = inflate(&strm, Z_NO_FLUSH);
+        if (std::memchr(head, '\0', sizeof(head) - strm.avail_out)) break;
+    }
+    if (ret != Z_OK && ret != Z_STREAM_END) {
+        std::cerr << "inflate error: " << ret << '\n';
+        return false;
+    }
+
+    produced = sizeof(head) - strm.avail_out;
+    return parseHeader(path, head, produced, type, size, headerEnd);
+}
+
+// The same for objects of zstd repositories (storage/zstd_codec.hpp).
+bool zstdHeader(ZstdDecoder& decoder, const std::string& path, char (&head)[64], ObjectType& type,
+                uint64_t& size, size_t& headerEnd, size_t& produced, bool& done)
+{
+    produced = 0;
+    done     = false;
+    while (produced < sizeof(head) && !done && !std::memchr(head, '\0', produced)) {
+        size_t got = 0;
+        if (!decoder.read(head + produced, sizeof(head) - produced, got, done)) return false;
+        produced += got;
+    }
+    return parseHeader(path, head, produced, type, size, headerEnd);
+}
+
+bool readZstdObject(const MappedFile& map, const std::string& path, ObjectType& type,
+                    std::string& content)
+{
+    ZstdDecoder decoder;
+    char     head[64];
+    uint64_t size = 0;
+    size_t   headerEnd = 0, produced = 0;
+    bool     done = false;
+    if (!decoder.begin(map.data(), map.size()) ||
+        !zstdHeader(decoder, path, head, type, size, headerEnd, produced, done))
+        return false;
+
+    size_t filled = produced - headerEnd;
+    content.resize(size);
+    std::memcpy(content.data(), head + headerEnd, filled);
+    while (!done) {
+        // one byte past the end catches content longer than the header says
+        char   extra;
+        size_t got = 0;
+        const bool full = filled == size;
+        if (!decoder.read(full ? &extra : content.data() + filled, full ? 1 : size - filled, got, done))
+            return false;
+        if (full && got) {
+            std::cerr << "Object larger than its header says: " << path << '\n';
+            return false;
+        }
+        filled += got;
+    }
+    if (filled != size) {
+        std::cerr << "Object shorter than its header says: " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool streamZstdObject(const MappedFile& map, const std::string& path, ObjectType& type,
+                      const ObjectSink& sink)
+{
+    ZstdDecoder decoder;
+    char     head[64];
+    uint64_t size = 0;
+    size_t   headerEnd = 0, produced = 0;
+    bool     done = false;
+    if (!decoder.begin(map.data(), map.size()) ||
+        !zstdHeader(decoder, path, head, type, size, headerEnd, produced, done))
+        return false;
+
+    uint64_t left = size - (produced - headerEnd);
+    if (!sink(head + headerEnd, produced - headerEnd)) return false;
+
+    static thread_local char buf[STREAM_CHUNK];
+    while (!done) {
+        size_t got = 0;
+        if (!decoder.read(buf, sizeof(buf), got, done)) return false;
+        if (got > left) {
+            std::cerr << "Object larger than its header says: " << path << '\n';
+            return false;
+        }
+        left -= got;
+        if (!sink(buf, got)) return false;
+    }
+    if (left != 0) {
+        std::cerr << "Object shorter than its header says: " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool readLooseObject(const std::string& path, ObjectType& type, std::string& content, bool* missing)
+{
+    MappedFile map;
+    if (missing) *missing = false;
+    if (!map.open(path)) {
+        if (missing) *missing = true;
+        return false;
+    }
+
+    if (isZstdFrame(map.data(), map.size())) return readZstdObject(map, path, type, content);
+
+    const unsigned char* next = map.data();
+    const unsigned char* end  = map.data() + map.size();
+
+    z_stream strm{};
+    if (inflateInit(&strm) != Z_OK) {
+        std::cerr << "inflateInit failed\n";
+        return false;
+    }
+
+    char     head[64];
+    uint64_t size = 0;
+    size_t   headerEnd = 0, produced = 0;
+    if (!inflateHeader(strm, next, end, path, head, type, size, headerEnd, produced)) {
+        inflateEnd(&strm);
+        return false;
+    }
+
+    const size_t already = produced - headerEnd;
+    content.resize(size);
+    std::memcpy(content.data(), head + headerEnd, already);
+
+    // output is handed over in slices for the same reason as the input
+    char*  out  = content.data() + already;
+    size_t left = size - already;
+    int    ret  = Z_OK;
+    strm.avail_out = 0;
+    while (ret != Z_STREAM_END) {
+        feedInput(strm, next, end);
+        if (strm.avail_out == 0 && left) {
+            const size_t chunk = std::min<size_t>(left, 1u << 30);
+            strm.next_out  = reinterpret_cast<Bytef*>(out);
+            strm.avail_out = static_cast<uInt>(chunk);
+            out  += chunk;
+            left -= chunk;
+        }
+        ret = inflate(&strm, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END) {
+            std::cerr << "inflate error: " << ret << '\n';
+            inflateEnd(&strm);
+            return false;
+        }
+    }
+    inflateEnd(&strm);
+
+    if (left != 0 || strm.avail_out != 0) {
+        std::cerr << "Object shorter than its header says: " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool streamLooseObject(const std::string& path, ObjectType& type, const ObjectSink& sink, bool* missing)
+{
+    MappedFile map;
+    if (missing) *missing = false;
+    if (!map.open(path)) {
+        if (missing) *missing = true;
+        return false;
+    }
+
+    if (isZstdFrame(map.data(), map.size())) return streamZstdObject(map, path, type, sink);
+
+    const unsigned char* next = map.data();
+    const unsigned char* end  = map.data() + map.size();
+
+    z_stream strm{};
+    if (inflateInit(&strm) != Z_OK) {
+        std::cerr << "inflateInit failed\n";
+        return false;
+    }
+
+    char     head[64];
+    uint64_t size = 0;
+    size_t   headerEnd = 0, produced = 0;
+    if (!inflateHeader(strm, next, end, path, head, type, size, headerEnd, produced)) {
+        inflateEnd(&strm);
+        return false;
+    }
+
+    uint64_t left = size - (produced - headerEnd);
+    bool     ok   = sink(head + headerEnd, produced - headerEnd);
+
+    static thread_local char buf[STREAM_CHUNK];
+    int ret = Z_OK;
+    while (ok && ret != Z_STREAM_END) {
+        // consumed input is dropped so resident memory stays flat
+        if (strm.avail_in == 0) map.discard(map.data(), next);
+        feedInput(strm, next, end, STREAM_INPUT_SLICE);
+        strm.next_out  = reinterpret_cast<Bytef*>(buf);
+        strm.avail_out = sizeof(buf);
+        ret = inflate(&strm, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END) {
+            std::cerr << "inflate error: " << ret << '\n';
+            ok = false;
+            break;
+        }
+        const size_t got = sizeof(buf) - strm.avail_out;
+        if (got > left) {
+            std::cerr << "Object larger than its header says: " << path << '\n';
+            ok = false;
+            break;
+        }
+        left -= got;
+        ok = sink(buf, got);
+    }
+    inflateEnd(&strm);
+
+    if (ok && left != 0) {
+        std::cerr << "Object shorter than its header says: " << path << '\n';
+        return false;
+    }
+    return ok;
+}
+
+bool peekLooseObject(const std::string& path, ObjectType& type, uint64_t& size, bool* missing)
+{
+    MappedFile map;
+    if (missing) *missing = false;
+    if (!map.open(path)) {
+        if (missing) *missing = true;
+        return false;
+    }
+
+    if (isZstdFrame(map.data(), map.size())) {
+        ZstdDecoder decoder;
+        char   head[64];
+        size_t headerEnd = 0, produced = 0;
+        bool   done = false;
+        return decoder.begin(map.data(), map.size()) &&
+               zstdHeader(decoder, path, head, type, size, headerEnd, produced, done);
+    }
+
+    const unsigned char* next = map.data();
+    const unsigned char* end  = map.data() + map.size();
+
+    z_stream strm{};
+    if (inflateInit(&strm) != Z_OK) {
+        std::cerr << "inflateInit failed\n";
+        return false;
+    }
+
+    char   head[64];
+    size_t headerEnd = 0, produced = 0;
+    const bool ok = inflateHeader(strm, next, end, path, head, type, size, headerEnd, produced);
+    inflateEnd(&strm);
+    return ok;
+}
+
+bool storeLooseObject(const ObjectId& id, std::string_view compressed)
+{
+    const std::string objectPath = getObjectPath(id);
+    const std::string dir        = std::filesystem::path(objectPath).parent_path().string();
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    // under its final name only once complete: a crash or a full disk must
+    // not leave a truncated object that KnownObjects would take as stored
+    std::string tmpPath = dir + "/tmp_obj_XXXXXX";
+    const int out = ::mkstemp(tmpPath.data());
+    if (out < 0) {
+        std::cerr << "Failed to create temporary object file\n";
+        return false;
+    }
+    ::fchmod(out, 0644);
+    const bool written = writeAll(out, reinterpret_cast<const unsigned char*>(compressed.data()), compressed.size());
+    if (::close(out) != 0 || !written || ::rename(tmpPath.c_str(), objectPath.c_str()) != 0) {
+        ::unlink(tmpPath.c_str());
+        std::cerr << "Failed to write object " << id << '\n';
+        return false;
+    }
+    return true;
+}
+
+ObjectId hashBlobFromFile(const std::string& filePath)
+{
+    const int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return {};
+    struct stat st{};
+    ObjectId    id;
+    const bool  ok = ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+                     hashBlobFile(fd, static_cast<uint64_t>(st.st_size), id);
+    ::close(fd);
+    return ok ? id : ObjectId();
+}
+
+ObjectId writeLooseBlobFromFile(const std::string& filePath)
+{
+    const int in = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        std::cerr << "Failed to open file: " << filePath << '\n';
+        return {};
+    }
+    struct stat st{};
+    if (::fstat(in, &st) != 0 || !S_ISREG(st.st_mode)) {
+        std::cerr << "Not a regular file: " << filePath << '\n';
+        ::close(in);
+        return {};
+    }
+    const uint64_t size = static_cast<uint64_t>(st.st_size);
+
+    // Small files are cheaper to read in one go than to hash and deflate in
+    // two passes; the memory is bounded by the limit, and writeObject still
+    // goes through a temporary file, so the object appears whole or not at all.
+    if (size <= SMALL_BLOB_LIMIT) {
+        std::string content;
+        const bool  read = readWhole(in, size, content);
+        ::close(in);
+        if (!read) {
+            std::cerr << "Failed to read file: " << filePath << '\n';
+            return {};
+        }
+        return writeObject("blob", content);
+    }
+
+    // Reading the file twice is far cheaper than deflating it: the first
+    // pass names the object, and content already in the store stops there.
+    ObjectId id;
+    if (!hashBlobFile(in, size, id)) {
+        std::cerr << "Failed to read file: " << filePath << '\n';
+        ::close(in);
+        return {};
+    }
+    if (!KnownObjects::instance().claim(id)) {
+        ::close(in);
+        return id;
+    }
+
+    // same directory as the final object, so the rename cannot cross filesystems
+    std::error_code ec;
+    std::filesystem::create_directories(".git/objects", ec);
+    std::string tmpPath = ".git/objects/tmp_obj_XXXXXX";
+    const int out = ::mkstemp(tmpPath.data());
+    if (out < 0) {
+        std::cerr << "Failed to create temporary object file\n";
+        KnownObjects::instance().forget(id);
+        ::close(in);
+        return {};
+    }
+
+    // mkstemp creates 0600; match what storeLooseObject leaves behind
+    ::fchmod(out, 0644);
+
+    Sha1 sha;
+    // the level is picked from the start of the file, as for small blobs
+    char sample[STREAM_SAMPLE];
+    const ssize_t sampled = ::pread(in, sample, sizeof(sample), 0);
+    const int level = levelFor(std::string_view(sample, sampled > 0 ? static_cast<size_t>(sampled) : 0));
+    const bool  zstd = objectCodec() == ObjectCodec::Zstd;
+    z_stream    strm{};
+    ZstdEncoder encoder;
+    const bool  started = zstd ? encoder.begin(level) : deflateInit(&strm, level) == Z_OK;
+
+    auto fail = [&](const char* what) {
+        std::cerr << what << ": " << filePath << '\n';
+        deflateEnd(&strm);
+        ::close(in);
+        ::close(out);
+        ::unlink(tmpPath.c_str());
+        KnownObjects::instance().forget(id);
+        return ObjectId();
+    };
+    if (!started) return fail("Compression failed");
+
+    // whatever comes out of either codec goes straight to the file
+    std::string piece;
+    auto compress = [&](const unsigned char* data, size_t n, bool finish) {
+        if (!zstd) return deflateTo(strm, out, data, n, finish ? Z_FINISH : Z_NO_FLUSH);
+        piece.clear();
+        return encoder.update(data, n, finish, piece) &&
+               writeAll(out, reinterpret_cast<const unsigned char*>(piece.data()), piece.size());
+    };
+
+    const std::string header = "blob " + std::to_string(size) + '\0';
+    sha.update(header);
+    if (!compress(reinterpret_cast<const unsigned char*>(header.data()), header.size(), false))
+        return fail("Compression failed");
+
+    unsigned char buf[STREAM_CHUNK];
+    uint64_t total = 0;
+    for (;;) {
+        const ssize_t n = ::read(in, buf, sizeof(buf));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return fail("Failed to read file");
+        }
+        if (n == 0) break;
+        total += static_cast<uint64_t>(n);
+        if (total > size) break;
+        sha.update(buf, static_cast<size_t>(n));
+        if (!compress(buf, static_cast<size_t>(n), false)) return fail("Compression failed");
+    }
+    // the header has already been hashed, so a file that changes size
+    // under us cannot be stored consistently
+    if (total != size) return fail("File changed while being read");
+    if (!compress(nullptr, 0, true)) return fail("Compression failed");
+
+    // and one whose content changed between the passes would be misnamed
+    if (id != sha.finish()) return fail("File changed while being read");
+    deflateEnd(&strm);
+    ::close(in);
+    if (::close(out) != 0) {
+        ::unlink(tmpPath.c_str());
+        KnownObjects::instance().forget(id);
+        std::cerr << "Failed to write object for: " << filePath << '\n';
+        return {};
+    }
+
+    const std::string objectPath = getObjectPath(id);
+    std::filesystem::create_directories(std::filesystem::path(objectPath).parent_path(), ec);
+    if (::rename(tmpPath.c_str(), objectPath.c_str()) != 0) {
+        ::unlink(tmpPath.c_str());
+        KnownObjects::instance().forget(id);
+        std::cerr << "Failed to store object " << id << '\n';
+        return {};
+    }
+    KnownObjects::instance().stored(id);
+    return id;
+}
+
+
+std::vector<ObjectId> writeLooseBlobsFromFiles(const std::vector<std::string>& filePaths)
+{
+    std::vector<ObjectId>    ids(filePaths.size());
+    std::vector<size_t>      small;
+    std::vector<std::string> headers, contents;
+    for (size_t i = 0; i < filePaths.size(); ++i) {
+        const int in = ::open(filePaths[i].c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st{};
+        if (in < 0 || ::fstat(in, &st) != 0 || !S_ISREG(st.st_mode) ||
+            static_cast<uint64_t>(st.st_size) > BATCH_BLOB_LIMIT) {
+            // large files and errors take the usual path
+            if (in >= 0) ::close(in);
+            ids[i] = writeLooseBlobFromFile(filePaths[i]);
+            continue;
+        }
+        std::string content;
+        const bool  read = readWhole(in, static_cast<uint64_t>(st.st_size), content);
+        ::close(in);
+        if (!read) {
+            std::cerr << "Failed to read file: " << filePaths[i] << '\n';
+            continue;
+        }
+        small.push_back(i);
+        headers.push_back("blob " + std::to_string(content.size()) + '\0');
+        contents.push_back(std::move(content));
+    }
+
+    std::vector<HashInput> inputs(small.size());
+    for (size_t k = 0; k < small.size(); ++k) inputs[k] = { headers[k], contents[k] };
+    const std::vector<ObjectId> names = hashObjects(inputs);
+    for (size_t k = 0; k < small.size(); ++k) ids[small[k]] = writeObject("blob", contents[k], names[k]);
+    return ids;
+}
+
+}
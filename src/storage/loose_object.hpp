@@ -0,0 +1,48 @@
+#pragma once
+#include "pack.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vit::storage {
+
+// Inflates a loose object file straight from its memory mapping. The
+// header is decoded first so the content buffer is allocated once, at its
+// final size. Returns false if the file is missing or corrupt; `missing`
+// tells the two apart.
+bool readLooseObject(const std::string& path, ObjectType& type, std::string& content,
+                     bool* missing = nullptr);
+
+// Like readLooseObject, but hands the content to `sink` in fixed-size
+// chunks as it is inflated instead of materialising it.
+bool streamLooseObject(const std::string& path, ObjectType& type, const ObjectSink& sink,
+                       bool* missing = nullptr);
+
+// Inflates only the "<type> <size>\0" header of a loose object.
+bool peekLooseObject(const std::string& path, ObjectType& type, uint64_t& size,
+                     bool* missing = nullptr);
+
+// Writes the already compressed object `id` to its loose object path
+// through a temporary file in the same fan-out directory, renamed into
+// place once written and closed. False, with a message, on failure.
+bool storeLooseObject(const ObjectId& id, std::string_view compressed);
+
+// Stores the regular file at `filePath` as a loose blob without loading
+// it: the header comes from the file size, then fixed-size chunks are fed
+// to SHA-1 and deflate together and written to a temporary file, which is
+// renamed into place once the object name is known. Files up to 1 MiB are
+// read in one go and stored with writeObject, through a temporary file as
+// well. Memory use does not depend on the size of the file. Returns the object name, or the null id on failure.
+ObjectId writeLooseBlobFromFile(const std::string& filePath);
+
+// writeLooseBlobFromFile for each of `filePaths`, in order. Files of up
+// to 64 KiB are read first and named in one hashObjects call, which hashes
+// several at once where the CPU allows.
+std::vector<ObjectId> writeLooseBlobsFromFiles(const std::vector<std::string>& filePaths);
+
+// The name the regular file at `filePath` would get as a blob, read in
+// fixed-size chunks and stored nowhere. The null id if it cannot be read.
+ObjectId hashBlobFromFile(const std::string& filePath);
+
+}
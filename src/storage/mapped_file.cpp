@@ -0,0 +1,75 @@
+#include "mapped_file.hpp"
+
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace vit::storage {
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      valid_(std::exchange(other.valid_, false)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        data_  = std::exchange(other.data_, nullptr);
+        size_  = std::exchange(other.size_, 0);
+        valid_ = std::exchange(other.valid_, false);
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            size_ = 0;
+            return false;
+        }
+        data_ = static_cast<const unsigned char*>(p);
+    }
+    // the mapping keeps the file alive, the descriptor is no longer needed
+    ::close(fd);
+    valid_ = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_) ::munmap(const_cast<unsigned char*>(data_), size_);
+    data_  = nullptr;
+    size_  = 0;
+    valid_ = false;
+}
+
+void MappedFile::discard(const unsigned char* begin, const unsigned char* end) const
+{
+    static const uintptr_t pageSize = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+    const uintptr_t from = (reinterpret_cast<uintptr_t>(begin) + pageSize - 1) & ~(pageSize - 1);
+    const uintptr_t to   = reinterpret_cast<uintptr_t>(end) & ~(pageSize - 1);
+    if (!valid_ || to <= from) return;
+    ::madvise(reinterpret_cast<void*>(from), to - from, MADV_DONTNEED);
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace vit::storage {
+
+// Read-only memory mapping of a whole file. Move-only; unmaps on destruction.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool                 valid() const { return valid_; }
+    const unsigned char* data()  const { return data_; }
+    size_t               size()  const { return size_; }
+
+    // Drops the whole pages inside [begin, end) from this process's
+    // resident set once a streaming reader is done with them. The data stays
+    // in the page cache and faults back in if touched again.
+    void discard(const unsigned char* begin, const unsigned char* end) const;
+
+private:
+    const unsigned char* data_  = nullptr;
+    size_t               size_  = 0;
+    bool                 valid_ = false;
+};
+
+}
@@ -0,0 +1,118 @@
+#include "object_cache.hpp"
+
+#include <cstdlib>
+
+namespace vit::storage {
+
+namespace {
+
+constexpr size_t DEFAULT_CACHE_MB = 64;
+
+size_t configuredLimit()
+{
+    const char* env = std::getenv("VIT_OBJECT_CACHE_MB");
+    if (!env || !*env) return DEFAULT_CACHE_MB * 1024 * 1024;
+
+    char* end = nullptr;
+    const unsigned long long mb = std::strtoull(env, &end, 10);
+    if (end == env || *end) return DEFAULT_CACHE_MB * 1024 * 1024;
+    return static_cast<size_t>(mb) * 1024 * 1024;
+}
+
+}
+
+ObjectCache& ObjectCache::instance()
+{
+    static ObjectCache cache(configuredLimit());
+    return cache;
+}
+
+ObjectCache::Shard& ObjectCache::shardFor(const ObjectId& id)
+{
+    // OIDs are uniformly distributed, so the first byte is as good a
+    // shard key as any hash of the whole name.
+    return shards_[id.bytes[0] % SHARD_COUNT];
+}
+
+std::shared_ptr<const std::string> ObjectCache::get(const ObjectId& id, ObjectType& type)
+{
+    Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    const auto it = shard.map.find(id);
+    if (it == shard.map.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    type = it->second->type;
+    return it->second->content;
+}
+
+void ObjectCache::put(const ObjectId& id, ObjectType type,
+                      std::shared_ptr<const std::string> content)
+{
+    const size_t budget = shardLimit();
+    const size_t cost   = content->size() + ENTRY_OVERHEAD;
+    // Anything taking more than a quarter of a shard would flush the
+    // small, hot trees and commits the cache is really for.
+    if (cost > budget / 4) return;
+
+    Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.map.count(id)) return;
+
+    shard.lru.push_front(Entry{id, type, std::move(content), cost});
+    shard.map.emplace(id, shard.lru.begin());
+    shard.bytes += cost;
+    evict(shard, budget);
+}
+
+void ObjectCache::evict(Shard& shard, size_t budget)
+{
+    while (shard.bytes > budget && !shard.lru.empty()) {
+        const Entry& victim = shard.lru.back();
+        shard.bytes -= victim.cost;
+        shard.map.erase(victim.id);
+        shard.lru.pop_back();
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void ObjectCache::setLimit(size_t bytes)
+{
+    limit_.store(bytes, std::memory_order_relaxed);
+    const size_t budget = shardLimit();
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        evict(shard, budget);
+    }
+}
+
+void ObjectCache::clear()
+{
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.lru.clear();
+        shard.map.clear();
+        shard.bytes = 0;
+    }
+}
+
+ObjectCache::Stats ObjectCache::stats() const
+{
+    Stats s;
+    s.hits      = hits_.load(std::memory_order_relaxed);
+    s.misses    = misses_.load(std::memory_order_relaxed);
+    s.evictions = evictions_.load(std::memory_order_relaxed);
+    s.limit     = limit();
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        s.entries += shard.map.size();
+        s.bytes   += shard.bytes;
+    }
+    return s;
+}
+
+}
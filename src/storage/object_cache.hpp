@@ -0,0 +1,76 @@
+#pragma once
+#include "pack.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace vit::storage {
+
+// Process-wide LRU cache of inflated objects keyed by binary OID and bounded
+// in bytes. Trees and commits are read many times over during checkout, log
+// and diff; the cache lets those readers share one inflated copy. Entries
+// are split over a few independently locked shards so concurrent readers
+// rarely contend.
+//
+// The default budget is 64 MiB and can be changed per process with
+// VIT_OBJECT_CACHE_MB (0 disables the cache).
+class ObjectCache {
+public:
+    struct Stats {
+        uint64_t hits      = 0;
+        uint64_t misses    = 0;
+        uint64_t evictions = 0;
+        size_t   entries   = 0;
+        size_t   bytes     = 0;
+        size_t   limit     = 0;
+    };
+
+    static ObjectCache& instance();
+
+    std::shared_ptr<const std::string> get(const ObjectId& id, ObjectType& type);
+    void put(const ObjectId& id, ObjectType type, std::shared_ptr<const std::string> content);
+
+    void   setLimit(size_t bytes);
+    size_t limit() const { return limit_.load(std::memory_order_relaxed); }
+    void   clear();
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        ObjectId                           id;
+        ObjectType                         type;
+        std::shared_ptr<const std::string> content;
+        size_t                             cost;
+    };
+
+    struct Shard {
+        mutable std::mutex                                         mutex;
+        size_t                                                     bytes = 0;
+        std::list<Entry>                                           lru;   // most recent first
+        std::unordered_map<ObjectId, std::list<Entry>::iterator>   map;
+    };
+
+    static constexpr size_t SHARD_COUNT    = 16;
+    static constexpr size_t ENTRY_OVERHEAD = 96;   // list node and map node
+
+    explicit ObjectCache(size_t limitBytes) : limit_(limitBytes) {}
+
+    Shard& shardFor(const ObjectId& id);
+    size_t shardLimit() const { return limit() / SHARD_COUNT; }
+    void   evict(Shard& shard, size_t budget);
+
+    std::array<Shard, SHARD_COUNT> shards_;
+    std::atomic<size_t>            limit_;
+    std::atomic<uint64_t>          hits_{0};
+    std::atomic<uint64_t>          misses_{0};
+    std::atomic<uint64_t>          evictions_{0};
+};
+
+}
@@ -0,0 +1,68 @@
+#include "object_id.hpp"
+
+#include <ostream>
+
+namespace vit::storage {
+
+namespace {
+
+constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+// Value of each hex digit, 0xff for anything else.
+constexpr std::array<unsigned char, 256> makeDecodeTable()
+{
+    std::array<unsigned char, 256> table{};
+    for (auto& v : table) v = 0xff;
+    for (int i = 0; i < 10; ++i) table['0' + i] = static_cast<unsigned char>(i);
+    for (int i = 0; i < 6; ++i) {
+        table['a' + i] = static_cast<unsigned char>(10 + i);
+        table['A' + i] = static_cast<unsigned char>(10 + i);
+    }
+    return table;
+}
+
+constexpr auto DECODE = makeDecodeTable();
+
+}
+
+void encodeHex(const unsigned char* raw, size_t n, char* out)
+{
+    for (size_t i = 0; i < n; ++i) {
+        out[2 * i]     = HEX_DIGITS[raw[i] >> 4];
+        out[2 * i + 1] = HEX_DIGITS[raw[i] & 0x0f];
+    }
+}
+
+bool decodeHex(const char* hex, size_t n, unsigned char* out)
+{
+    for (size_t i = 0; i < n; ++i) {
+        const unsigned char hi = DECODE[static_cast<unsigned char>(hex[2 * i])];
+        const unsigned char lo = DECODE[static_cast<unsigned char>(hex[2 * i + 1])];
+        if ((hi | lo) & 0xf0) return false;
+        out[i] = static_cast<unsigned char>((hi << 4) | lo);
+    }
+    return true;
+}
+
+ObjectId ObjectId::fromHex(std::string_view hex)
+{
+    ObjectId id;
+    if (hex.size() != HEX_SIZE || !decodeHex(hex.data(), RAW_SIZE, id.bytes.data())) return {};
+    return id;
+}
+
+std::string ObjectId::hex() const
+{
+    std::string out(HEX_SIZE, '\0');
+    encodeHex(bytes.data(), RAW_SIZE, out.data());
+    return out;
+}
+
+std::ostream& operator<<(std::ostream& out, const ObjectId& id)
+{
+    char buf[ObjectId::HEX_SIZE];
+    encodeHex(id.data(), ObjectId::RAW_SIZE, buf);
+    return out.write(buf, sizeof(buf));
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+namespace vit::storage {
+
+// Hex digits for `n` raw bytes, written to `out` (2 * n chars, lowercase).
+void encodeHex(const unsigned char* raw, size_t n, char* out);
+
+// Decodes 2 * n hex digits into `out`; false on any non-hex digit.
+bool decodeHex(const char* hex, size_t n, unsigned char* out);
+
+// A SHA-1 object name held as its 20 raw bytes. Trivially copyable,
+// comparable and hashable, so names can be passed around and kept in sets
+// without allocating; hex is only produced for paths and output. The
+// all-zero name stands for "no object", as in git.
+struct ObjectId {
+    static constexpr size_t RAW_SIZE = 20;
+    static constexpr size_t HEX_SIZE = 40;
+
+    std::array<unsigned char, RAW_SIZE> bytes{};
+
+    static ObjectId fromRaw(const void* raw)
+    {
+        ObjectId id;
+        std::memcpy(id.bytes.data(), raw, RAW_SIZE);
+        return id;
+    }
+
+    // The null id unless `hex` is exactly 40 hex digits.
+    static ObjectId fromHex(std::string_view hex);
+
+    std::string          hex() const;
+    std::string_view     raw() const  { return {reinterpret_cast<const char*>(bytes.data()), RAW_SIZE}; }
+    const unsigned char* data() const { return bytes.data(); }
+    bool                 isNull() const { return *this == ObjectId(); }
+
+    friend bool operator==(const ObjectId&, const ObjectId&) = default;
+    friend auto operator<=>(const ObjectId&, const ObjectId&) = default;
+};
+
+std::ostream& operator<<(std::ostream& out, const ObjectId& id);
+
+}
+
+template <>
+struct std::hash<vit::storage::ObjectId> {
+    size_t operator()(const vit::storage::ObjectId& id) const noexcept
+    {
+        // object names are uniformly distributed already
+        size_t h;
+        std::memcpy(&h, id.bytes.data(), sizeof(h));
+        return h;
+    }
+};
@@ -0,0 +1,102 @@
+#include "object_store.hpp"
+#include "loose_object.hpp"
+#include "object_cache.hpp"
+#include "../commit.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace vit::storage {
+
+bool loadObject(const ObjectId& id, ObjectType& type, std::string& content)
+{
+    if (PackStore::instance().read(id, type, content)) return true;
+
+    bool missing = false;
+    if (readLooseObject(getObjectPath(id), type, content, &missing)) return true;
+    if (missing) std::cerr << "Object not found: " << id << '\n';
+    return false;
+}
+
+bool peekObjectHeader(const ObjectId& id, ObjectType& type, uint64_t& size)
+{
+    if (PackStore::instance().peek(id, type, size)) return true;
+
+    bool missing = false;
+    if (peekLooseObject(getObjectPath(id), type, size, &missing)) return true;
+    if (missing) std::cerr << "Object not found: " << id << '\n';
+    return false;
+}
+
+std::shared_ptr<const std::string> loadObjectShared(const ObjectId& id, ObjectType& type)
+{
+    ObjectCache& cache = ObjectCache::instance();
+    if (auto hit = cache.get(id, type)) return hit;
+
+    auto content = std::make_shared<std::string>();
+    if (!loadObject(id, type, *content)) return nullptr;
+    cache.put(id, type, content);
+    return content;
+}
+
+bool streamObject(const ObjectId& id, ObjectType& type, const ObjectSink& sink, std::string* error)
+{
+    if (auto cached = ObjectCache::instance().get(id, type))
+        return sink(cached->data(), cached->size());
+    if (PackStore::instance().contains(id))
+        return PackStore::instance().stream(id, type, sink);
+
+    bool missing = false;
+    if (streamLooseObject(getObjectPath(id), type, sink, &missing)) return true;
+    if (missing) {
+        const std::string message = "Object not found: " + id.hex();
+        if (error) *error = message;
+        else       std::cerr << message << '\n';
+    }
+    return false;
+}
+
+bool writeObjectToFile(const ObjectId& id, const std::string& path, std::string* error)
+{
+    auto fail = [&](const std::string& message) {
+        if (error) *error = message;
+        else       std::cerr << message << '\n';
+        return false;
+    };
+
+    // The content goes to a file beside `path`, which replaces it only once
+    // all of it is out: a missing or corrupt object leaves the old file be.
+    static std::atomic<unsigned> sequence{0};
+    const std::string tmpPath = path + ".tmp" + std::to_string(::getpid()) + '.' +
+                                std::to_string(sequence.fetch_add(1, std::memory_order_relaxed));
+    const int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (fd < 0) return fail("Failed to open " + path + " for writing");
+    // the file that is replaced keeps its permissions, exec bit included
+    struct stat st;
+    if (::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) ::fchmod(fd, st.st_mode & 07777);
+
+    ObjectType  type;
+    std::string reason;
+    bool ok = streamObject(id, type, [fd](const char* data, size_t size) {
+        while (size) {
+            const ssize_t n = ::write(fd, data, size);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }, &reason);
+    if (::close(fd) != 0) ok = false;
+    if (ok && ::rename(tmpPath.c_str(), path.c_str()) == 0) return true;
+    ::unlink(tmpPath.c_str());
+    return fail("Failed to write " + path + (reason.empty() ? "" : " (" + reason + ')'));
+}
+
+}
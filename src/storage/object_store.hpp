@@ -0,0 +1,35 @@
+#pragma once
+#include "pack.hpp"
+
+#include <memory>
+#include <string>
+
+namespace vit::storage {
+
+// Looks an object up in the packs first and then among loose objects,
+// returning its type and content without the "<type> <size>\0" header.
+bool loadObject(const ObjectId& id, ObjectType& type, std::string& content);
+
+// Type and size of an object, inflating no more than its header. Use this
+// wherever objects only need classifying.
+bool peekObjectHeader(const ObjectId& id, ObjectType& type, uint64_t& size);
+
+// Same lookup, going through the process-wide ObjectCache. The returned
+// buffer is shared with the cache and other readers; nullptr if missing.
+std::shared_ptr<const std::string> loadObjectShared(const ObjectId& id, ObjectType& type);
+
+// Hands an object's content to `sink` without holding all of it in memory
+// where the storage allows (loose objects and whole pack entries). A
+// missing object is reported in `error` when one is given, else on stderr.
+bool streamObject(const ObjectId& id, ObjectType& type, const ObjectSink& sink,
+                  std::string* error = nullptr);
+
+// Writes an object's content to `path`, replacing the file, through
+// streamObject. Used by checkout so large blobs take constant memory. The
+// file is only replaced once the whole object has been written, and keeps
+// the permissions of the file it replaces.
+// Failures, a missing object included, are reported on stderr, or stored
+// in `error` when one is given.
+bool writeObjectToFile(const ObjectId& id, const std::string& path, std::string* error = nullptr);
+
+}
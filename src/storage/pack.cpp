@@ -0,0 +1,873 @@
+#include "pack.hpp"
+#include "bitmap_index.hpp"
+#include "commit_graph.hpp"
+#include "commit_view.hpp"
+#include "compression.hpp"
+#include "delta.hpp"
+#include "known_objects.hpp"
+#include "object_store.hpp"
+#include "sha1.hpp"
+#include "tree_view.hpp"
+#include "../commit.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <unordered_set>
+#include <unistd.h>
+
+#include <zlib.h>
+
+namespace vit::storage {
+
+namespace {
+
+constexpr uint32_t PACK_SIGNATURE = 0x5041434b; // "PACK"
+constexpr uint32_t PACK_VERSION   = 2;
+constexpr size_t   MAX_CHAIN_WALK = 10000;      // guards against cyclic corrupt packs
+
+uint32_t readBE32(const unsigned char* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+void appendBE32(std::string& out, uint32_t v)
+{
+    out += static_cast<char>(v >> 24);
+    out += static_cast<char>(v >> 16);
+    out += static_cast<char>(v >> 8);
+    out += static_cast<char>(v);
+}
+
+std::string objectHeader(ObjectType type, size_t size)
+{
+    return std::string(typeName(type)) + ' ' + std::to_string(size) + '\0';
+}
+
+bool isDelta(ObjectType type)
+{
+    return type == ObjectType::OfsDelta || type == ObjectType::RefDelta;
+}
+
+bool compressData(const std::string& data, std::string& out)
+{
+    return zlibCompress(data, levelFor(data), out);
+}
+
+// Streams bytes to disk while keeping the running SHA-1 for the pack trailer.
+class PackWriter {
+public:
+    explicit PackWriter(const std::string& path)
+        : out_(path, std::ios::binary) {}
+
+    bool ok() const { return static_cast<bool>(out_); }
+
+    void write(const std::string& data)
+    {
+        sha_.update(data);
+        out_.write(data.data(), data.size());
+        offset_ += data.size();
+    }
+
+    uint64_t offset() const { return offset_; }
+
+    // Appends the trailing checksum and returns it in binary form.
+    std::string finish()
+    {
+        const std::string trailer(sha_.finish().raw());
+        out_.write(trailer.data(), trailer.size());
+        out_.close();
+        return trailer;
+    }
+
+private:
+    std::ofstream out_;
+    Sha1          sha_;
+    uint64_t      offset_ = 0;
+};
+
+std::string encodeEntryHeader(ObjectType type, uint64_t size)
+{
+    std::string out;
+    unsigned char c = static_cast<unsigned char>((static_cast<uint8_t>(type) << 4) | (size & 0x0f));
+    size >>= 4;
+    while (size) {
+        out += static_cast<char>(c | 0x80);
+        c = size & 0x7f;
+        size >>= 7;
+    }
+    out += static_cast<char>(c);
+    return out;
+}
+
+// OFS_DELTA base distance: big-endian 7-bit groups, each continuation
+// implicitly adding one so that no value has two encodings.
+std::string encodeBaseDistance(uint64_t distance)
+{
+    unsigned char buf[16];
+    size_t pos = sizeof(buf) - 1;
+    buf[pos] = distance & 0x7f;
+    while (distance >>= 7)
+        buf[--pos] = 0x80 | (--distance & 0x7f);
+    return std::string(reinterpret_cast<char*>(buf + pos), sizeof(buf) - pos);
+}
+
+// Same spreading of path names as git's pack_name_hash: the last characters
+// weigh most, so "foo.c" in different directories sorts together.
+uint32_t nameHash(const std::string& name)
+{
+    uint32_t hash = 0;
+    for (unsigned char c : name) {
+        if (std::isspace(c)) continue;
+        hash = (hash >> 2) + (static_cast<uint32_t>(c) << 24);
+    }
+    return hash;
+}
+
+// Path of every object reachable from the refs, so that repack can group
+// successive versions of the same file next to each other.
+std::unordered_map<ObjectId, std::string> collectObjectNames()
+{
+    std::unordered_map<ObjectId, std::string> names;
+    std::unordered_set<ObjectId> seenTrees;
+
+    std::function<void(const ObjectId&, const std::string&)> walkTree =
+        [&](const ObjectId& treeHash, const std::string& base) {
+            if (!seenTrees.insert(treeHash).second) return;
+            for (const auto& f : TreeView(treeHash)) {
+                std::string path = base;
+                if (!path.empty()) path += '/';
+                path += f.name;
+                names.emplace(f.id, path);
+                if (f.isDirectory()) walkTree(f.id, path);
+            }
+        };
+
+    const CommitGraph& graph = CommitGraph::instance();
+    for (const auto& commit : getReachableCommits(collectReferenceCommits())) {
+        uint32_t pos;
+        const ObjectId tree = graph.lookup(commit, pos) ? graph.treeAt(pos) : CommitView(commit).tree();
+        names.emplace(commit, "");
+        if (!tree.isNull()) {
+            names.emplace(tree, "");
+            walkTree(tree, "");
+        }
+    }
+    return names;
+}
+
+struct RepackEntry {
+    ObjectId    id;
+    ObjectType  type = ObjectType::None;
+    uint64_t    size = 0;
+    uint32_t    nameHash = 0;
+};
+
+// An object recently written to the pack that later objects may delta against.
+struct WindowSlot {
+    ObjectType                  type;
+    std::string                 content;
+    uint64_t                    offset;
+    int                         depth;
+    std::unique_ptr<DeltaIndex> index;   // built on first use
+};
+
+} // namespace
+
+
+const char* typeName(ObjectType type)
+{
+    switch (type) {
+        case ObjectType::Commit: return "commit";
+        case ObjectType::Tree:   return "tree";
+        case ObjectType::Blob:   return "blob";
+        case ObjectType::Tag:    return "tag";
+        default:                 return "";
+    }
+}
+
+ObjectType typeFromName(const std::string& name)
+{
+    if (name == "commit") return ObjectType::Commit;
+    if (name == "tree")   return ObjectType::Tree;
+    if (name == "blob")   return ObjectType::Blob;
+    if (name == "tag")    return ObjectType::Tag;
+    return ObjectType::None;
+}
+
+
+/* ---------- DeltaBaseCache ---------- */
+
+std::shared_ptr<std::string> DeltaBaseCache::get(uint64_t offset, ObjectType& type)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = map_.find(offset);
+    if (it == map_.end()) return nullptr;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    type = it->second->type;
+    return it->second->content;
+}
+
+void DeltaBaseCache::put(uint64_t offset, ObjectType type, std::shared_ptr<std::string> content)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (content->size() > limit_ || map_.count(offset)) return;
+
+    bytes_ += content->size();
+    lru_.push_front(Entry{offset, type, std::move(content)});
+    map_[offset] = lru_.begin();
+
+    while (bytes_ > limit_) {
+        const Entry& victim = lru_.back();
+        bytes_ -= victim.content->size();
+        map_.erase(victim.offset);
+        lru_.pop_back();
+    }
+}
+
+
+/* ---------- PackFile ---------- */
+
+std::unique_ptr<PackFile> PackFile::open(const std::string& packPath)
+{
+    std::unique_ptr<PackFile> pack(new PackFile());
+    pack->path_ = packPath;
+    if (!pack->map_.open(packPath) || pack->map_.size() < 12 + ObjectId::RAW_SIZE) return nullptr;
+
+    const unsigned char* header = pack->map_.data();
+    if (readBE32(header) != PACK_SIGNATURE || readBE32(header + 4) != PACK_VERSION) {
+        std::cerr << "Not a version 2 pack: " << packPath << '\n';
+        return nullptr;
+    }
+
+    const std::string idxPath = std::filesystem::path(packPath).replace_extension(".idx").string();
+    if (!pack->index_.open(idxPath)) {
+        if (!pack->indexPack(idxPath) || !pack->index_.open(idxPath)) {
+            std::cerr << "Failed to index " << packPath << '\n';
+            return nullptr;
+        }
+    }
+    if (pack->index_.objectCount() != readBE32(header + 8)) {
+        std::cerr << "Index does not match pack: " << idxPath << '\n';
+        return nullptr;
+    }
+    return pack;
+}
+
+// Recreates a missing .idx by walking every entry once, like git index-pack.
+bool PackFile::indexPack(const std::string& idxPath)
+{
+    const uint32_t count = readBE32(map_.data() + 8);
+    std::vector<PackIndexEntry> entries(count);
+
+    // first pass: entry boundaries and CRCs
+    uint64_t offset = 12;
+    for (uint32_t i = 0; i < count; ++i) {
+        EntryHeader h;
+        std::string data;
+        uint64_t    end = 0;
+        if (!readEntryHeader(offset, h) || !inflateEntry(h, data, &end)) {
+            std::cerr << "Corrupt pack entry at offset " << offset << " in " << path_ << '\n';
+            return false;
+        }
+
+        entries[i].offset = offset;
+        entries[i].crc32  = static_cast<uint32_t>(crc32_z(0L, map_.data() + offset, end - offset));
+        offset = end;
+    }
+
+    if (offset + ObjectId::RAW_SIZE > map_.size()) return false;
+    const std::string checksum(reinterpret_cast<const char*>(map_.data() + offset), ObjectId::RAW_SIZE);
+
+    // second pass: object names. REF_DELTAs may name a base that appears
+    // later in the pack, so keep going while each round resolves something.
+    std::vector<size_t> unresolved(count);
+    for (size_t i = 0; i < count; ++i) unresolved[i] = i;
+    while (!unresolved.empty()) {
+        std::vector<size_t> later;
+        for (size_t i : unresolved) {
+            ObjectType  type;
+            std::string content;
+            if (!readObjectAt(entries[i].offset, type, content)) {
+                later.push_back(i);
+                continue;
+            }
+            entries[i].id = hashObject(objectHeader(type, content.size()), content);
+            pendingOffsets_[entries[i].id] = entries[i].offset;
+        }
+        if (later.size() == unresolved.size()) {
+            std::cerr << "Unresolvable deltas in " << path_ << '\n';
+            return false;
+        }
+        unresolved = std::move(later);
+    }
+    pendingOffsets_.clear();
+
+    return PackIndex::write(idxPath, std::move(entries), checksum);
+}
+
+bool PackFile::contains(const ObjectId& id) const
+{
+    size_t pos;
+    return index_.lookup(id, pos);
+}
+
+bool PackFile::read(const ObjectId& id, ObjectType& type, std::string& content)
+{
+    uint64_t offset;
+    if (!index_.find(id, offset)) return false;
+
+    if (!readObjectAt(offset, type, content)) {
+        std::cerr << "Failed to read " << id << " from " << path_ << '\n';
+        return false;
+    }
+    return true;
+}
+
+std::vector<ObjectId> PackFile::objectHashes() const
+{
+    std::vector<ObjectId> out;
+    out.reserve(index_.objectCount());
+    for (size_t i = 0; i < index_.objectCount(); ++i) out.push_back(index_.hashAt(i));
+    return out;
+}
+
+bool PackFile::findOffset(const ObjectId& id, uint64_t& offset) const
+{
+    if (index_.find(id, offset)) return true;
+    const auto it = pendingOffsets_.find(id);
+    if (it == pendingOffsets_.end()) return false;
+    offset = it->second;
+    return true;
+}
+
+bool PackFile::stream(const ObjectId& id, ObjectType& type, const ObjectSink& sink)
+{
+    uint64_t offset;
+    if (!index_.find(id, offset)) return false;
+
+    EntryHeader h;
+    bool ok = readEntryHeader(offset, h);
+    if (ok && !isDelta(h.type)) {
+        type = h.type;
+        ok = inflateEntryTo(h, sink);
+    } else if (ok) {
+        std::string content;
+        ok = readObjectAt(offset, type, content) && sink(content.data(), content.size());
+    }
+    if (!ok) std::cerr << "Failed to read " << id << " from " << path_ << '\n';
+    return ok;
+}
+
+bool PackFile::peek(const ObjectId& id, ObjectType& type, uint64_t& size)
+{
+    uint64_t offset;
+    if (!index_.find(id, offset)) return false;
+
+    EntryHeader h;
+    if (!readEntryHeader(offset, h)) return false;
+    if (!isDelta(h.type)) {
+        type = h.type;
+        size = h.size;
+        return true;
+    }
+
+    // both varints of a delta header fit in the first 20 bytes
+    char   prefix[20];
+    size_t produced = 0;
+    if (!inflatePrefix(h, prefix, sizeof(prefix), produced) ||
+        !deltaTargetSize(std::string_view(prefix, produced), size))
+        return false;
+
+    for (size_t depth = 0; isDelta(h.type); ++depth) {
+        uint64_t base = h.baseOffset;
+        if (depth > MAX_CHAIN_WALK) return false;
+        if (h.type == ObjectType::RefDelta && !findOffset(h.baseHash, base)) return false;
+        if (!readEntryHeader(base, h)) return false;
+    }
+    type = h.type;
+    return true;
+}
+
+bool PackFile::readEntryHeader(uint64_t offset, EntryHeader& h)
+{
+    if (offset >= map_.size()) return false;
+    const unsigned char* buf   = map_.data() + offset;
+    const size_t         avail = map_.size() - offset;
+
+    size_t p = 0;
+    unsigned char c = buf[p++];
+    h.offset = offset;
+    h.type   = static_cast<ObjectType>((c >> 4) & 0x07);
+    h.size   = c & 0x0f;
+    int shift = 4;
+    while (c & 0x80) {
+        if (p >= avail || shift > 60) return false;
+        c = buf[p++];
+        h.size |= static_cast<uint64_t>(c & 0x7f) << shift;
+        shift  += 7;
+    }
+
+    if (h.type == ObjectType::OfsDelta) {
+        if (p >= avail) return false;
+        c = buf[p++];
+        uint64_t distance = c & 0x7f;
+        while (c & 0x80) {
+            if (p >= avail) return false;
+            c = buf[p++];
+            distance = ((distance + 1) << 7) | (c & 0x7f);
+        }
+        if (distance == 0 || distance > offset) return false;
+        h.baseOffset = offset - distance;
+    } else if (h.type == ObjectType::RefDelta) {
+        if (p + ObjectId::RAW_SIZE > avail) return false;
+        h.baseHash = ObjectId::fromRaw(buf + p);
+        p += ObjectId::RAW_SIZE;
+    } else if (typeName(h.type)[0] == '\0') {
+        return false;
+    }
+
+    h.dataOffset = offset + p;
+    return true;
+}
+
+// Inflates straight out of the mapping into a buffer of the recorded size.
+bool PackFile::inflateEntry(const EntryHeader& h, std::string& out, uint64_t* endOffset)
+{
+    if (h.dataOffset > map_.size()) return false;
+    const unsigned char* next = map_.data() + h.dataOffset;
+    const unsigned char* end  = map_.data() + map_.size();
+
+    out.resize(h.size);
+    z_stream strm{};
+    if (inflateInit(&strm) != Z_OK) return false;
+
+    // zlib counts in 32-bit units, so huge entries are fed in slices
+    char*    dst  = out.data();
+    uint64_t left = h.size;
+    int      ret  = Z_OK;
+    strm.next_out = reinterpret_cast<Bytef*>(dst);   // zlib rejects a null buffer even when empty
+    while (ret != Z_STREAM_END) {
+        if (strm.avail_in == 0 && next != end) {
+            const size_t chunk = std::min<size_t>(end - next, 1u << 30);
+            strm.next_in  = const_cast<Bytef*>(next);
+            strm.avail_in = static_cast<uInt>(chunk);
+            next += chunk;
+        }
+        if (strm.avail_out == 0 && left) {
+            const size_t chunk = std::min<uint64_t>(left, 1u << 30);
+            strm.next_out  = reinterpret_cast<Bytef*>(dst);
+            strm.avail_out = static_cast<uInt>(chunk);
+            dst  += chunk;
+            left -= chunk;
+        }
+        ret = inflate(&strm, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END) break;
+    }
+    const bool ok = ret == Z_STREAM_END && left == 0 && strm.avail_out == 0;
+    if (endOffset) *endOffset = h.dataOffset + strm.total_in;
+    inflateEnd(&strm);
+    return ok;
+}
+
+// Same, but through a fixed-size buffer handed to `sink` as it fills.
+bool PackFile::inflateEntryTo(const EntryHeader& h, const ObjectSink& sink)
+{
+    if (h.dataOffset > map_.size()) return false;
+    const unsigned char* next = map_.data() + h.dataOffset;
+    const unsigned char* end  = map_.data() + map_.size();
+
+    z_stream strm{};
+    if (inflateInit(&strm) != Z_OK) return false;
+
+    static thread_local char buf[128 * 1024];
+    const unsigned char* start = next;
+    uint64_t left = h.size;
+    int      ret  = Z_OK;
+    bool     ok   = true;
+    while (ok && ret != Z_STREAM_END) {
+        if (strm.avail_in == 0 && next != end) {
+            // small slices, dropped once consumed, keep resident memory flat
+            map_.discard(start, next);
+            const size_t chunk = std::min<size_t>(end - next, 1024 * 1024);
+            strm.next_in  = const_cast<Bytef*>(next);
+            strm.avail_in = static_cast<uInt>(chunk);
+            next += chunk;
+        }
+        strm.next_out  = reinterpret_cast<Bytef*>(buf);
+        strm.avail_out = sizeof(buf);
+        ret = inflate(&strm, Z_NO_FLUSH);
+        const size_t got = sizeof(buf) - strm.avail_out;
+        ok = (ret == Z_OK || ret == Z_STREAM_END) && got <= left && sink(buf, got);
+        left -= ok ? got : 0;
+    }
+    inflateEnd(&strm);
+    return ok && left == 0;
+}
+
+// Inflates at most `capacity` bytes from the start of an entry.
+bool PackFile::inflatePrefix(const EntryHeader& h, char* out, size_t capacity, size_t& produced)
+{
+    if (h.dataOffset > map_.size()) return false;
+    const size_t avail = std::min<size_t>(map_.size() - h.dataOffset, 1u << 30);
+
+    z_stream strm{};
+    if (inflateInit(&strm) != Z_OK) return false;
+    strm.next_in   = const_cast<Bytef*>(map_.data() + h.dataOffset);
+    strm.avail_in  = static_cast<uInt>(avail);
+    strm.next_out  = reinterpret_cast<Bytef*>(out);
+    strm.avail_out = static_cast<uInt>(capacity);
+    const int ret = inflate(&strm, Z_SYNC_FLUSH);
+    produced = capacity - strm.avail_out;
+    inflateEnd(&strm);
+    return ret == Z_OK || ret == Z_STREAM_END || (ret == Z_BUF_ERROR && produced == capacity);
+}
+
+// Follows a delta chain down to a full object (or a cached base), then
+// applies the deltas back up. Every intermediate result goes into the
+// base cache, since siblings in the chain usually share those bases.
+bool PackFile::readObjectAt(uint64_t offset, ObjectType& type, std::string& content)
+{
+    std::vector<EntryHeader>     chain;
+    std::shared_ptr<std::string> base;
+    ObjectType                   baseType = ObjectType::None;
+
+    uint64_t cur = offset;
+    while (true) {
+        if ((base = baseCache_.get(cur, baseType))) break;
+
+        EntryHeader h;
+        if (!readEntryHeader(cur, h)) return false;
+        if (!isDelta(h.type)) {
+            base     = std::make_shared<std::string>();
+            baseType = h.type;
+            if (!inflateEntry(h, *base, nullptr)) return false;
+            if (!chain.empty()) baseCache_.put(cur, baseType, base);
+            break;
+        }
+
+        chain.push_back(h);
+        if (chain.size() > MAX_CHAIN_WALK) return false;
+        if (h.type == ObjectType::OfsDelta) cur = h.baseOffset;
+        else if (!findOffset(h.baseHash, cur)) return false;
+    }
+
+    for (size_t i = chain.size(); i-- > 0;) {
+        std::string delta;
+        if (!inflateEntry(chain[i], delta, nullptr)) return false;
+        auto result = std::make_shared<std::string>();
+        if (!applyDelta(*base, delta, *result)) return false;
+        base = std::move(result);
+        if (i > 0) baseCache_.put(chain[i].offset, baseType, base);
+    }
+
+    type = baseType;
+    if (base.use_count() == 1) content = std::move(*base);
+    else                       content = *base;
+    return true;
+}
+
+
+/* ---------- PackStore ---------- */
+
+PackStore& PackStore::instance()
+{
+    static PackStore store;
+    return store;
+}
+
+void PackStore::ensureLoaded()
+{
+    if (loaded_) return;
+    loaded_ = true;
+
+    const std::string packDir = ".git/objects/pack";
+    if (!std::filesystem::exists(packDir)) return;
+    for (const auto& e : std::filesystem::directory_iterator(packDir)) {
+        if (e.path().extension() != ".pack") continue;
+        if (auto pack = PackFile::open(e.path().string())) packs_.push_back(std::move(pack));
+    }
+}
+
+std::vector<std::shared_ptr<PackFile>> PackStore::snapshot()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ensureLoaded();
+    return packs_;
+}
+
+bool PackStore::contains(const ObjectId& id)
+{
+    for (const auto& pack : snapshot())
+        if (pack->contains(id)) return true;
+    return false;
+}
+
+bool PackStore::read(const ObjectId& id, ObjectType& type, std::string& content)
+{
+    for (const auto& pack : snapshot())
+        if (pack->read(id, type, content)) return true;
+    return false;
+}
+
+bool PackStore::peek(const ObjectId& id, ObjectType& type, uint64_t& size)
+{
+    for (const auto& pack : snapshot())
+        if (pack->peek(id, type, size)) return true;
+    return false;
+}
+
+bool PackStore::stream(const ObjectId& id, ObjectType& type, const ObjectSink& sink)
+{
+    for (const auto& pack : snapshot())
+        if (pack->contains(id)) return pack->stream(id, type, sink);
+    return false;
+}
+
+std::vector<ObjectId> PackStore::objectHashes()
+{
+    std::vector<ObjectId> out;
+    for (const auto& pack : snapshot()) {
+        auto hashes = pack->objectHashes();
+        out.insert(out.end(), hashes.begin(), hashes.end());
+    }
+    return out;
+}
+
+std::vector<std::string> PackStore::packPaths()
+{
+    std::vector<std::string> out;
+    for (const auto& pack : snapshot()) out.push_back(pack->path());
+    return out;
+}
+
+size_t PackStore::packCount()
+{
+    return snapshot().size();
+}
+
+void PackStore::reload()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    packs_.clear();
+    loaded_ = false;
+}
+
+
+/* ---------- repacking ---------- */
+
+std::vector<ObjectId> listLooseObjects()
+{
+    std::vector<ObjectId> out;
+    const std::string objectsDir = ".git/objects";
+    if (!std::filesystem::exists(objectsDir)) return out;
+
+    for (const auto& dir : std::filesystem::directory_iterator(objectsDir)) {
+        const std::string prefix = dir.path().filename().string();
+        if (!dir.is_directory() || prefix.size() != 2) continue;
+        for (const auto& file : std::filesystem::directory_iterator(dir.path())) {
+            const ObjectId id = ObjectId::fromHex(prefix + file.path().filename().string());
+            if (!id.isNull()) out.push_back(id);
+        }
+    }
+    return out;
+}
+
+RepackResult repackObjects(const RepackOptions& options)
+{
+    RepackResult result;
+
+    const std::vector<ObjectId> loose = listLooseObjects();
+    std::vector<std::string> oldPacks;
+    std::vector<ObjectId> hashes = loose;
+    if (options.all) {
+        oldPacks = PackStore::instance().packPaths();
+        std::unordered_set<ObjectId> seen(hashes.begin(), hashes.end());
+        for (const auto& id : PackStore::instance().objectHashes())
+            if (seen.insert(id).second) hashes.push_back(id);
+    }
+    if (hashes.empty()) {
+        result.success = true;
+        return result;
+    }
+
+    // Sort so that candidate bases sit close together: same type, same
+    // file name, and larger (usually newer) versions first. Only headers
+    // are read here; contents are loaded as objects enter the window.
+    const auto names = collectObjectNames();
+    std::vector<RepackEntry> order;
+    order.reserve(hashes.size());
+    for (const auto& id : hashes) {
+        RepackEntry e;
+        if (!peekObjectHeader(id, e.type, e.size)) {
+            result.error = "Failed to read object " + id.hex();
+            return result;
+        }
+        e.id = id;
+        if (const auto it = names.find(id); it != names.end())
+            e.nameHash = nameHash(it->second);
+        order.push_back(std::move(e));
+    }
+    std::stable_sort(order.begin(), order.end(), [](const RepackEntry& a, const RepackEntry& b) {
+        if (a.type != b.type)         return a.type < b.type;
+        if (a.nameHash != b.nameHash) return a.nameHash < b.nameHash;
+        return a.size > b.size;
+    });
+
+    const std::string packDir = ".git/objects/pack";
+    std::filesystem::create_directories(packDir);
+    const std::string tmpPath = packDir + "/tmp_pack_" + std::to_string(::getpid());
+
+    std::string trailer;
+    std::vector<PackIndexEntry> entries;
+    entries.reserve(order.size());
+    {
+        PackWriter writer(tmpPath);
+        if (!writer.ok()) {
+            result.error = "Failed to create " + tmpPath;
+            return result;
+        }
+
+        std::string header = "PACK";
+        appendBE32(header, PACK_VERSION);
+        appendBE32(header, static_cast<uint32_t>(order.size()));
+        writer.write(header);
+
+        std::deque<std::unique_ptr<WindowSlot>> window;
+        for (const auto& obj : order) {
+            auto slot = std::make_unique<WindowSlot>();
+            if (!loadObject(obj.id, slot->type, slot->content)) {
+                result.error = "Failed to read object " + obj.id.hex();
+                writer.finish();
+                std::filesystem::remove(tmpPath);
+                return result;
+            }
+            slot->offset = writer.offset();
+            slot->depth  = 0;
+
+            // try every window entry as a base and keep the smallest delta
+            const std::string& content = slot->content;
+            std::string bestDelta;
+            WindowSlot* bestBase = nullptr;
+            const size_t limit = content.size() / 2 > 20 ? content.size() / 2 - 20 : 0;
+            for (auto& cand : window) {
+                if (cand->type != slot->type || cand->depth >= options.depth) continue;
+                const size_t srcSize = cand->content.size();
+                if (srcSize < content.size() / 32) continue;
+                const size_t maxSize = bestDelta.empty() ? limit : bestDelta.size() - 1;
+                const size_t sizeDiff = srcSize > content.size() ? srcSize - content.size()
+                                                                 : content.size() - srcSize;
+                if (maxSize == 0 || sizeDiff >= maxSize) continue;
+
+                if (!cand->index) cand->index = std::make_unique<DeltaIndex>(cand->content);
+                std::string delta = cand->index->createDelta(content, maxSize);
+                if (!delta.empty()) {
+                    bestDelta = std::move(delta);
+                    bestBase  = cand.get();
+                }
+            }
+
+            std::string entryHeader, compressed;
+            bool compressedOk;
+            if (bestBase) {
+                slot->depth  = bestBase->depth + 1;
+                entryHeader  = encodeEntryHeader(ObjectType::OfsDelta, bestDelta.size()) +
+                               encodeBaseDistance(slot->offset - bestBase->offset);
+                compressedOk = compressData(bestDelta, compressed);
+                ++result.deltas;
+            } else {
+                entryHeader  = encodeEntryHeader(slot->type, content.size());
+                compressedOk = compressData(content, compressed);
+            }
+            if (!compressedOk) {
+                result.error = "Compression failed for " + obj.id.hex();
+                writer.finish();
+                std::filesystem::remove(tmpPath);
+                return result;
+            }
+
+            PackIndexEntry e;
+            e.id      = obj.id;
+            e.offset  = slot->offset;
+            e.crc32   = crc32(0L, reinterpret_cast<const Bytef*>(entryHeader.data()), entryHeader.size());
+            e.crc32   = crc32(e.crc32, reinterpret_cast<const Bytef*>(compressed.data()), compressed.size());
+            entries.push_back(std::move(e));
+
+            writer.write(entryHeader);
+            writer.write(compressed);
+
+            window.push_back(std::move(slot));
+            if (window.size() > static_cast<size_t>(std::max(options.window, 0))) window.pop_front();
+        }
+        trailer = writer.finish();
+    }
+
+    const std::string baseName = packDir + "/pack-" + binaryToHexString(trailer);
+    result.packPath = baseName + ".pack";
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, result.packPath, ec);
+    if (ec) {
+        result.error = "Failed to move " + tmpPath + " to " + result.packPath + ": " + ec.message();
+        std::filesystem::remove(tmpPath, ec);
+        return result;
+    }
+    if (!PackIndex::write(baseName + ".idx", std::move(entries), trailer)) {
+        result.error = "Failed to write " + baseName + ".idx";
+        return result;
+    }
+
+    // Only drop the old copies once the new pack has proven it can serve them.
+    const auto pack = PackFile::open(result.packPath);
+    if (!pack) {
+        result.error = "Failed to verify " + result.packPath;
+        return result;
+    }
+    for (const auto& id : hashes) {
+        ObjectType  type;
+        std::string content;
+        if (!pack->read(id, type, content)) {
+            result.error = "Pack cannot serve object " + id.hex();
+            return result;
+        }
+    }
+    result.packedObjects = pack->objectCount();
+
+    PackStore::instance().reload();
+    for (const auto& oldPack : oldPacks) {
+        if (oldPack == result.packPath) continue;
+        std::error_code ec;
+        std::filesystem::remove(std::filesystem::path(oldPack).replace_extension(".idx"), ec);
+        std::filesystem::remove(std::filesystem::path(oldPack).replace_extension(".vbitmap"), ec);
+        if (std::filesystem::remove(oldPack, ec)) ++result.removedPacks;
+    }
+
+    for (const auto& id : loose) {
+        std::error_code ec;
+        if (std::filesystem::remove(getObjectPath(id), ec)) ++result.removedLoose;
+    }
+    KnownObjects::instance().reset();
+    std::vector<std::filesystem::path> emptyDirs;
+    for (const auto& dir : std::filesystem::directory_iterator(".git/objects")) {
+        std::error_code ec;
+        if (dir.is_directory() && dir.path().filename().string().size() == 2 &&
+            std::filesystem::is_empty(dir.path(), ec))
+            emptyDirs.push_back(dir.path());
+    }
+    for (const auto& dir : emptyDirs) {
+        std::error_code ec;
+        std::filesystem::remove(dir, ec);
+    }
+
+    // only a pack holding every object can have bitmaps covering whole histories
+    if (options.all && !writeBitmapIndex(result.packPath, &result.bitmaps))
+        BitmapIndex::instance().reload();
+
+    result.success = true;
+    return result;
+}
+
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include "mapped_file.hpp"
+#include "object_id.hpp"
+#include "pack_index.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vit::storage {
+
+// Object type codes as they appear in pack entry headers.
+enum class ObjectType : uint8_t {
+    None     = 0,
+    Commit   = 1,
+    Tree     = 2,
+    Blob     = 3,
+    Tag      = 4,
+    OfsDelta = 6,
+    RefDelta = 7
+};
+
+const char* typeName(ObjectType type);
+ObjectType  typeFromName(const std::string& name);
+
+// Receives an object's content in order, a chunk at a time. Returning
+// false aborts the read.
+using ObjectSink = std::function<bool(const char* data, size_t size)>;
+
+/* ---------- delta base cache ---------- */
+
+// Objects recently materialised while walking delta chains, keyed by pack
+// offset and bounded in bytes, so that resolving many deltas against the
+// same bases does not inflate those bases over and over. Safe to share
+// between threads; cached bases are never modified.
+class DeltaBaseCache {
+public:
+    explicit DeltaBaseCache(size_t limitBytes) : limit_(limitBytes) {}
+
+    std::shared_ptr<std::string> get(uint64_t offset, ObjectType& type);
+    void put(uint64_t offset, ObjectType type, std::shared_ptr<std::string> content);
+
+private:
+    struct Entry {
+        uint64_t                     offset;
+        ObjectType                   type;
+        std::shared_ptr<std::string> content;
+    };
+
+    std::mutex                                              mutex_;
+    size_t                                                  limit_;
+    size_t                                                  bytes_ = 0;
+    std::list<Entry>                                        lru_;   // most recent first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> map_;
+};
+
+/* ---------- a single .pack file ---------- */
+// Lookups may run on any number of threads at once: the mapping and the
+// index are read-only and the delta base cache locks itself.
+class PackFile {
+public:
+    // Opens a pack through its .idx, building the index first if it is
+    // missing. Returns nullptr on a malformed pack.
+    static std::unique_ptr<PackFile> open(const std::string& packPath);
+
+    bool contains(const ObjectId& id) const;
+
+    bool read(const ObjectId& id, ObjectType& type, std::string& content);
+
+    // Whole (non-delta) entries are inflated straight into `sink`; deltas
+    // have to be resolved in memory first.
+    bool stream(const ObjectId& id, ObjectType& type, const ObjectSink& sink);
+
+    // Type and size of an object from entry headers alone. For deltas this
+    // walks the chain headers for the type and inflates just the start of
+    // the delta for the size.
+    bool peek(const ObjectId& id, ObjectType& type, uint64_t& size);
+
+    std::vector<ObjectId> objectHashes() const;
+    size_t                objectCount() const { return index_.objectCount(); }
+    const std::string&    path() const        { return path_; }
+
+private:
+    struct EntryHeader {
+        uint64_t    offset     = 0;
+        ObjectType  type       = ObjectType::None;
+        uint64_t    size       = 0;   // inflated size of the entry data
+        uint64_t    dataOffset = 0;   // start of the zlib stream
+        uint64_t    baseOffset = 0;   // OFS_DELTA base entry
+        ObjectId    baseHash;         // REF_DELTA base object
+    };
+
+    PackFile() : baseCache_(DELTA_BASE_CACHE_LIMIT) {}
+
+    bool readEntryHeader(uint64_t offset, EntryHeader& h);
+    bool inflateEntry(const EntryHeader& h, std::string& out, uint64_t* endOffset);
+    bool inflateEntryTo(const EntryHeader& h, const ObjectSink& sink);
+    bool inflatePrefix(const EntryHeader& h, char* out, size_t capacity, size_t& produced);
+    bool readObjectAt(uint64_t offset, ObjectType& type, std::string& content);
+    bool findOffset(const ObjectId& id, uint64_t& offset) const;
+    bool indexPack(const std::string& idxPath);
+
+    static constexpr size_t DELTA_BASE_CACHE_LIMIT = 96 * 1024 * 1024;
+
+    std::string    path_;
+    MappedFile     map_;
+    PackIndex      index_;
+    DeltaBaseCache baseCache_;
+    std::unordered_map<ObjectId, uint64_t> pendingOffsets_;  // used while indexing
+};
+
+/* ---------- every pack under .git/objects/pack ---------- */
+class PackStore {
+public:
+    static PackStore& instance();
+
+    bool contains(const ObjectId& id);
+    bool read(const ObjectId& id, ObjectType& type, std::string& content);
+    bool stream(const ObjectId& id, ObjectType& type, const ObjectSink& sink);
+    bool peek(const ObjectId& id, ObjectType& type, uint64_t& size);
+
+    std::vector<ObjectId>    objectHashes();   // every packed object
+    std::vector<std::string> packPaths();
+    size_t                   packCount();
+
+    // Forget loaded packs so the next lookup rescans the pack directory.
+    void reload();
+
+private:
+    PackStore() = default;
+    void ensureLoaded();
+
+    // The loaded packs. Lookups go through a copy taken under the lock and
+    // run without it; the copy keeps the packs alive across a reload().
+    std::vector<std::shared_ptr<PackFile>> snapshot();
+
+    std::mutex                             mutex_;   // guards loaded_ and packs_
+    bool                                   loaded_ = false;
+    std::vector<std::shared_ptr<PackFile>> packs_;
+};
+
+/* ---------- repacking ---------- */
+struct RepackOptions {
+    bool all    = false;   // also rewrite objects already in packs (-a)
+    int  window = 10;      // candidates tried as delta bases for each object
+    int  depth  = 50;      // longest delta chain allowed
+};
+
+struct RepackResult {
+    bool        success = false;
+    size_t      packedObjects = 0;
+    size_t      deltas = 0;
+    size_t      removedLoose = 0;
+    size_t      removedPacks = 0;
+    size_t      bitmaps = 0;   // commits given a reachability bitmap (-a only)
+    std::string packPath;
+    std::string error;
+};
+
+std::vector<ObjectId> listLooseObjects();
+
+// Writes loose objects (and with options.all, every packed object too) into
+// a new pack, storing objects as OFS_DELTAs against similar objects found
+// in a sliding window. The old copies are deleted once the pack has been
+// verified. With options.all the new pack also gets reachability bitmaps.
+RepackResult repackObjects(const RepackOptions& options = {});
+
+}
@@ -0,0 +1,166 @@
+#include "pack_index.hpp"
+#include "sha1.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+namespace vit::storage {
+
+namespace {
+
+constexpr unsigned char IDX_MAGIC[4] = { 0xff, 't', 'O', 'c' };
+constexpr uint32_t      IDX_VERSION  = 2;
+constexpr size_t        HASH_SIZE    = 20;
+constexpr size_t        HEADER_SIZE  = 8 + 256 * 4;
+
+uint32_t readBE32(const unsigned char* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+uint64_t readBE64(const unsigned char* p)
+{
+    return (uint64_t(readBE32(p)) << 32) | readBE32(p + 4);
+}
+
+void appendBE32(std::string& out, uint32_t v)
+{
+    out += static_cast<char>(v >> 24);
+    out += static_cast<char>(v >> 16);
+    out += static_cast<char>(v >> 8);
+    out += static_cast<char>(v);
+}
+
+} // namespace
+
+
+bool PackIndex::open(const std::string& idxPath)
+{
+    if (!map_.open(idxPath)) return false;
+
+    const unsigned char* p = map_.data();
+    if (map_.size() < HEADER_SIZE + 2 * HASH_SIZE ||
+        std::memcmp(p, IDX_MAGIC, sizeof(IDX_MAGIC)) != 0 ||
+        readBE32(p + 4) != IDX_VERSION) {
+        map_.close();
+        return false;
+    }
+
+    fanout_ = p + 8;
+    count_  = readBE32(fanout_ + 255 * 4);
+
+    const size_t fixed = HEADER_SIZE + size_t(count_) * (HASH_SIZE + 4 + 4);
+    if (map_.size() < fixed + 2 * HASH_SIZE) {
+        map_.close();
+        return false;
+    }
+    names_        = p + HEADER_SIZE;
+    crcs_         = names_ + size_t(count_) * HASH_SIZE;
+    offsets_      = crcs_ + size_t(count_) * 4;
+    largeOffsets_ = offsets_ + size_t(count_) * 4;
+    largeCount_   = (map_.size() - fixed - 2 * HASH_SIZE) / 8;
+    return true;
+}
+
+bool PackIndex::lookup(const ObjectId& id, size_t& pos) const
+{
+    if (!map_.valid()) return false;
+
+    const unsigned char first = id.bytes[0];
+    size_t lo = first == 0 ? 0 : readBE32(fanout_ + (first - 1) * 4);
+    size_t hi = readBE32(fanout_ + first * 4);
+
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        const int cmp = std::memcmp(names_ + mid * HASH_SIZE, id.data(), HASH_SIZE);
+        if (cmp == 0) {
+            pos = mid;
+            return true;
+        }
+        if (cmp < 0) lo = mid + 1;
+        else         hi = mid;
+    }
+    return false;
+}
+
+bool PackIndex::find(const ObjectId& id, uint64_t& offset) const
+{
+    size_t pos;
+    if (!lookup(id, pos)) return false;
+    offset = offsetAt(pos);
+    return true;
+}
+
+ObjectId PackIndex::hashAt(size_t pos) const
+{
+    return ObjectId::fromRaw(names_ + pos * HASH_SIZE);
+}
+
+uint64_t PackIndex::offsetAt(size_t pos) const
+{
+    const uint32_t off = readBE32(offsets_ + pos * 4);
+    if (!(off & 0x80000000u)) return off;
+
+    const size_t large = off & 0x7fffffffu;
+    return large < largeCount_ ? readBE64(largeOffsets_ + large * 8) : 0;
+}
+
+uint32_t PackIndex::crcAt(size_t pos) const
+{
+    return readBE32(crcs_ + pos * 4);
+}
+
+std::string PackIndex::packChecksum() const
+{
+    return std::string(reinterpret_cast<const char*>(map_.data() + map_.size() - 2 * HASH_SIZE), HASH_SIZE);
+}
+
+bool PackIndex::write(const std::string& idxPath, std::vector<PackIndexEntry> entries,
+                      const std::string& packChecksum)
+{
+    std::sort(entries.begin(), entries.end(),
+              [](const PackIndexEntry& a, const PackIndexEntry& b){ return a.id < b.id; });
+
+    std::string out(reinterpret_cast<const char*>(IDX_MAGIC), sizeof(IDX_MAGIC));
+    appendBE32(out, IDX_VERSION);
+
+    uint32_t fanout[256] = {};
+    for (const auto& e : entries) ++fanout[e.id.bytes[0]];
+    for (int i = 1; i < 256; ++i) fanout[i] += fanout[i - 1];
+    for (uint32_t n : fanout) appendBE32(out, n);
+
+    out.reserve(out.size() + entries.size() * (HASH_SIZE + 8) + 2 * HASH_SIZE);
+    for (const auto& e : entries) out += e.id.raw();
+    for (const auto& e : entries) appendBE32(out, e.crc32);
+
+    std::string large;
+    uint32_t    largeCount = 0;
+    for (const auto& e : entries) {
+        if (e.offset < 0x80000000u) {
+            appendBE32(out, static_cast<uint32_t>(e.offset));
+        } else {
+            appendBE32(out, 0x80000000u | largeCount++);
+            appendBE32(large, static_cast<uint32_t>(e.offset >> 32));
+            appendBE32(large, static_cast<uint32_t>(e.offset));
+        }
+    }
+    out += large;
+    out += packChecksum;
+
+    out += hashBytes(out.data(), out.size()).raw();
+
+    // publish atomically: readers either see no index or a complete one
+    const std::string tmpPath = idxPath + ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream f(tmpPath, std::ios::binary);
+        if (!f.write(out.data(), out.size())) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, idxPath, ec);
+    return !ec;
+}
+
+}
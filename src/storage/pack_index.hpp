@@ -0,0 +1,49 @@
+#pragma once
+#include "mapped_file.hpp"
+#include "object_id.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vit::storage {
+
+struct PackIndexEntry {
+    ObjectId    id;
+    uint64_t    offset = 0;
+    uint32_t    crc32  = 0;
+};
+
+// Git .idx version 2: a 256-entry fanout table over sorted object names,
+// followed by CRC32s, 31-bit offsets and a table for offsets past 2 GiB.
+// The file is mapped, so a lookup only touches the pages it bisects.
+class PackIndex {
+public:
+    bool open(const std::string& idxPath);
+
+    // Position of `id` in the sorted name table.
+    bool     lookup(const ObjectId& id, size_t& pos) const;
+    bool     find(const ObjectId& id, uint64_t& offset) const;
+
+    size_t      objectCount() const { return count_; }
+    ObjectId    hashAt(size_t pos) const;
+    uint64_t    offsetAt(size_t pos) const;
+    uint32_t    crcAt(size_t pos) const;
+    std::string packChecksum() const;
+
+    // Sorts entries and writes them as an .idx v2 file next to the pack.
+    static bool write(const std::string& idxPath, std::vector<PackIndexEntry> entries,
+                      const std::string& packChecksum);
+
+private:
+    MappedFile           map_;
+    uint32_t             count_        = 0;
+    const unsigned char* fanout_       = nullptr;
+    const unsigned char* names_        = nullptr;
+    const unsigned char* crcs_         = nullptr;
+    const unsigned char* offsets_      = nullptr;
+    const unsigned char* largeOffsets_ = nullptr;
+    size_t               largeCount_   = 0;
+};
+
+}
@@ -0,0 +1,499 @@
+#include "sha1.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include <openssl/evp.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define VIT_SHA1_X86 1
+#endif
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#include <arm_neon.h>
+#define VIT_SHA1_ARM 1
+#endif
+
+namespace vit::storage {
+
+namespace {
+
+constexpr uint32_t INITIAL_STATE[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+constexpr uint32_t K[4] = { 0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6 };
+
+uint32_t readBE32(const unsigned char* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+void writeBE32(unsigned char* p, uint32_t v)
+{
+    p[0] = static_cast<unsigned char>(v >> 24);
+    p[1] = static_cast<unsigned char>(v >> 16);
+    p[2] = static_cast<unsigned char>(v >> 8);
+    p[3] = static_cast<unsigned char>(v);
+}
+
+void writeBE64(unsigned char* p, uint64_t v)
+{
+    writeBE32(p, static_cast<uint32_t>(v >> 32));
+    writeBE32(p + 4, static_cast<uint32_t>(v));
+}
+
+ObjectId digestOf(const uint32_t (&state)[5])
+{
+    unsigned char raw[ObjectId::RAW_SIZE];
+    for (int i = 0; i < 5; ++i) writeBE32(raw + 4 * i, state[i]);
+    return ObjectId::fromRaw(raw);
+}
+
+
+#ifdef VIT_SHA1_X86
+
+bool cpuHasShaNi()
+{
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSE4_1)) return false;
+    return __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & bit_SHA);
+}
+
+bool cpuHasAvx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+// Four rounds, G of the twenty, with the message schedule for later
+// groups interleaved as the SHA-NI instructions expect it.
+template <int G>
+[[gnu::always_inline, gnu::target("sha,sse4.1")]]
+inline void shaNiGroup(__m128i& abcd, __m128i (&e)[2], __m128i (&msg)[4], const unsigned char* data)
+{
+    constexpr int cur = G % 2, next = 1 - cur;
+    if constexpr (G < 4) {
+        const __m128i swap = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+        msg[G] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * G)), swap);
+    }
+    if constexpr (G == 0) e[cur] = _mm_add_epi32(e[cur], msg[0]);
+    else                  e[cur] = _mm_sha1nexte_epu32(e[cur], msg[G % 4]);
+    e[next] = abcd;
+    if constexpr (G >= 3 && G <= 18) msg[(G + 1) % 4] = _mm_sha1msg2_epu32(msg[(G + 1) % 4], msg[G % 4]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e[cur], G / 5);
+    if constexpr (G >= 1 && G <= 16) msg[(G + 3) % 4] = _mm_sha1msg1_epu32(msg[(G + 3) % 4], msg[G % 4]);
+    if constexpr (G >= 2 && G <= 17) msg[(G + 2) % 4] = _mm_xor_si128(msg[(G + 2) % 4], msg[G % 4]);
+}
+
+template <int... G>
+[[gnu::always_inline, gnu::target("sha,sse4.1")]]
+inline void shaNiBlock(__m128i& abcd, __m128i (&e)[2], __m128i (&msg)[4], const unsigned char* data,
+                       std::integer_sequence<int, G...>)
+{
+    (shaNiGroup<G>(abcd, e, msg, data), ...);
+}
+
+[[gnu::target("sha,sse4.1")]]
+void shaNiBlocks(uint32_t (&state)[5], const unsigned char* data, size_t count)
+{
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1b);
+    __m128i e[2] = { _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0), _mm_setzero_si128() };
+    __m128i msg[4];
+    for (; count; --count, data += 64) {
+        const __m128i abcdSaved = abcd;
+        const __m128i eSaved    = e[0];
+        shaNiBlock(abcd, e, msg, data, std::make_integer_sequence<int, 20>());
+        e[0] = _mm_sha1nexte_epu32(e[0], eSaved);
+        abcd = _mm_add_epi32(abcd, abcdSaved);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1b));
+    state[4] = static_cast<uint32_t>(_mm_extract_epi32(e[0], 3));
+}
+
+
+// Eight independent messages, one per 32-bit lane.
+[[gnu::always_inline, gnu::target("avx2")]]
+inline __m256i rotl(__m256i x, int n)
+{
+    return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+}
+
+[[gnu::target("avx2")]]
+void avx2Blocks8(uint32_t (&state)[5][8], const unsigned char* const (&blocks)[8])
+{
+    alignas(32) uint32_t words[16][8];
+    for (int lane = 0; lane < 8; ++lane)
+        for (int t = 0; t < 16; ++t) words[t][lane] = readBE32(blocks[lane] + 4 * t);
+
+    __m256i w[16];
+    for (int t = 0; t < 16; ++t) w[t] = _mm256_load_si256(reinterpret_cast<const __m256i*>(words[t]));
+
+    __m256i s[5];
+    for (int i = 0; i < 5; ++i) s[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[i]));
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4];
+
+    for (int t = 0; t < 80; ++t) {
+        if (t >= 16) {
+            const __m256i x = _mm256_xor_si256(_mm256_xor_si256(w[(t - 3) & 15], w[(t - 8) & 15]),
+                                               _mm256_xor_si256(w[(t - 14) & 15], w[t & 15]));
+            w[t & 15] = rotl(x, 1);
+        }
+        __m256i f;
+        if (t < 20)      f = _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d)));
+        else if (t < 40) f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+        else if (t < 60) f = _mm256_or_si256(_mm256_and_si256(b, c), _mm256_and_si256(d, _mm256_or_si256(b, c)));
+        else             f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+
+        const __m256i k    = _mm256_set1_epi32(static_cast<int>(K[t / 20]));
+        const __m256i temp = _mm256_add_epi32(_mm256_add_epi32(rotl(a, 5), f),
+                                              _mm256_add_epi32(_mm256_add_epi32(e, k), w[t & 15]));
+        e = d;
+        d = c;
+        c = rotl(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    const __m256i out[5] = { a, b, c, d, e };
+    for (int i = 0; i < 5; ++i)
+        _mm256_store_si256(reinterpret_cast<__m256i*>(state[i]), _mm256_add_epi32(s[i], out[i]));
+}
+
+#endif // VIT_SHA1_X86
+
+
+#ifdef VIT_SHA1_ARM
+
+// Four rounds, G of the twenty; the schedule runs two groups ahead.
+template <int G>
+[[gnu::always_inline]]
+inline void armGroup(uint32x4_t& abcd, uint32_t (&e)[2], uint32x4_t (&tmp)[2], uint32x4_t (&msg)[4])
+{
+    constexpr int cur = G % 2, next = 1 - cur;
+    e[next] = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    if constexpr (G < 5)                abcd = vsha1cq_u32(abcd, e[cur], tmp[cur]);
+    else if constexpr (G >= 10 && G < 15) abcd = vsha1mq_u32(abcd, e[cur], tmp[cur]);
+    else                                abcd = vsha1pq_u32(abcd, e[cur], tmp[cur]);
+    if constexpr (G <= 17) tmp[cur] = vaddq_u32(msg[(G + 2) % 4], vdupq_n_u32(K[(G + 2) / 5]));
+    if constexpr (G >= 1 && G <= 16) msg[(G + 3) % 4] = vsha1su1q_u32(msg[(G + 3) % 4], msg[(G + 2) % 4]);
+    if constexpr (G <= 15) msg[G % 4] = vsha1su0q_u32(msg[G % 4], msg[(G + 1) % 4], msg[(G + 2) % 4]);
+}
+
+template <int... G>
+[[gnu::always_inline]]
+inline void armBlock(uint32x4_t& abcd, uint32_t (&e)[2], uint32x4_t (&tmp)[2], uint32x4_t (&msg)[4],
+                     std::integer_sequence<int, G...>)
+{
+    (armGroup<G>(abcd, e, tmp, msg), ...);
+}
+
+void armBlocks(uint32_t (&state)[5], const unsigned char* data, size_t count)
+{
+    uint32x4_t abcd = vld1q_u32(state);
+    uint32_t   e[2] = { state[4], 0 };
+    for (; count; --count, data += 64) {
+        const uint32x4_t abcdSaved = abcd;
+        const uint32_t   eSaved    = e[0];
+
+        uint32x4_t msg[4];
+        for (int i = 0; i < 4; ++i)
+            msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+        uint32x4_t tmp[2] = { vaddq_u32(msg[0], vdupq_n_u32(K[0])), vaddq_u32(msg[1], vdupq_n_u32(K[0])) };
+
+        armBlock(abcd, e, tmp, msg, std::make_integer_sequence<int, 20>());
+        e[0] += eSaved;
+        abcd = vaddq_u32(abcd, abcdSaved);
+    }
+    vst1q_u32(state, abcd);
+    state[4] = e[0];
+}
+
+#endif // VIT_SHA1_ARM
+
+
+bool supported(HashBackend backend)
+{
+    switch (backend) {
+    case HashBackend::OpenSSL: return true;
+#ifdef VIT_SHA1_X86
+    case HashBackend::ShaNi:   return cpuHasShaNi();
+#endif
+#ifdef VIT_SHA1_ARM
+    case HashBackend::ArmV8:   return true;
+#endif
+    default:                   return false;
+    }
+}
+
+HashBackend detectBackend()
+{
+    // VIT_SHA1_BACKEND names one to use instead, if this CPU has it
+    if (const char* env = std::getenv("VIT_SHA1_BACKEND"))
+        for (HashBackend b : { HashBackend::OpenSSL, HashBackend::ShaNi, HashBackend::ArmV8 })
+            if (std::strcmp(env, hashBackendName(b)) == 0 && supported(b)) return b;
+
+    if (supported(HashBackend::ShaNi)) return HashBackend::ShaNi;
+    if (supported(HashBackend::ArmV8)) return HashBackend::ArmV8;
+    return HashBackend::OpenSSL;
+}
+
+std::atomic<HashBackend>& currentBackend()
+{
+    static std::atomic<HashBackend> backend{detectBackend()};
+    return backend;
+}
+
+void compressBlocks(HashBackend backend, uint32_t (&state)[5], const unsigned char* data, size_t count)
+{
+#ifdef VIT_SHA1_X86
+    if (backend == HashBackend::ShaNi) return shaNiBlocks(state, data, count);
+#endif
+#ifdef VIT_SHA1_ARM
+    if (backend == HashBackend::ArmV8) return armBlocks(state, data, count);
+#endif
+    (void)backend, (void)state, (void)data, (void)count;
+}
+
+// Fetched once: looking the digest up by name on every hash costs as much
+// as hashing a small object.
+const EVP_MD* sha1Digest()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    static const EVP_MD* md = [] {
+        const EVP_MD* fetched = EVP_MD_fetch(nullptr, "SHA1", nullptr);
+        return fetched ? fetched : EVP_sha1();
+    }();
+    return md;
+#else
+    return EVP_sha1();
+#endif
+}
+
+// Digest contexts are reused by the thread that made them.
+struct EvpPool {
+    std::vector<EVP_MD_CTX*> free;
+    ~EvpPool() { for (EVP_MD_CTX* c : free) EVP_MD_CTX_free(c); }
+};
+thread_local EvpPool evpPool;
+
+} // namespace
+
+
+HashBackend hashBackend()
+{
+    return currentBackend().load(std::memory_order_relaxed);
+}
+
+const char* hashBackendName(HashBackend backend)
+{
+    switch (backend) {
+    case HashBackend::OpenSSL: return "openssl";
+    case HashBackend::ShaNi:   return "sha-ni";
+    case HashBackend::ArmV8:   return "armv8";
+    }
+    return "?";
+}
+
+bool setHashBackend(HashBackend backend)
+{
+    if (!supported(backend)) return false;
+    currentBackend().store(backend, std::memory_order_relaxed);
+    return true;
+}
+
+
+Sha1::Sha1() : backend_(hashBackend())
+{
+    if (backend_ == HashBackend::OpenSSL) {
+        EVP_MD_CTX* ctx;
+        if (evpPool.free.empty()) {
+            ctx = EVP_MD_CTX_new();
+        } else {
+            ctx = evpPool.free.back();
+            evpPool.free.pop_back();
+        }
+        EVP_DigestInit_ex(ctx, sha1Digest(), nullptr);
+        evp_ = ctx;
+        return;
+    }
+    std::memcpy(state_, INITIAL_STATE, sizeof(state_));
+}
+
+Sha1::~Sha1()
+{
+    if (evp_) evpPool.free.push_back(static_cast<EVP_MD_CTX*>(evp_));
+}
+
+void Sha1::update(const void* data, size_t size)
+{
+    if (evp_) {
+        EVP_DigestUpdate(static_cast<EVP_MD_CTX*>(evp_), data, size);
+        return;
+    }
+
+    const auto* p = static_cast<const unsigned char*>(data);
+    length_ += size;
+    if (used_) {
+        const size_t take = std::min(size, sizeof(block_) - used_);
+        std::memcpy(block_ + used_, p, take);
+        used_ += take;
+        p     += take;
+        size  -= take;
+        if (used_ < sizeof(block_)) return;
+        compressBlocks(backend_, state_, block_, 1);
+        used_ = 0;
+    }
+    if (const size_t blocks = size / 64) {
+        compressBlocks(backend_, state_, p, blocks);
+        p    += blocks * 64;
+        size -= blocks * 64;
+    }
+    std::memcpy(block_, p, size);
+    used_ = size;
+}
+
+ObjectId Sha1::finish()
+{
+    if (evp_) {
+        unsigned char sha[EVP_MAX_MD_SIZE];
+        unsigned int  len = 0;
+        EVP_DigestFinal_ex(static_cast<EVP_MD_CTX*>(evp_), sha, &len);
+        return len == ObjectId::RAW_SIZE ? ObjectId::fromRaw(sha) : ObjectId();
+    }
+
+    block_[used_++] = 0x80;
+    if (used_ > 56) {
+        std::memset(block_ + used_, 0, sizeof(block_) - used_);
+        compressBlocks(backend_, state_, block_, 1);
+        used_ = 0;
+    }
+    std::memset(block_ + used_, 0, 56 - used_);
+    writeBE64(block_ + 56, length_ * 8);
+    compressBlocks(backend_, state_, block_, 1);
+    return digestOf(state_);
+}
+
+
+ObjectId hashObject(std::string_view header, std::string_view content)
+{
+    Sha1 sha;
+    sha.update(header);
+    sha.update(content);
+    return sha.finish();
+}
+
+ObjectId hashBytes(const void* data, size_t size)
+{
+    Sha1 sha;
+    sha.update(data, size);
+    return sha.finish();
+}
+
+bool multiBufferHashing()
+{
+#ifdef VIT_SHA1_X86
+    static const bool avx2 = cpuHasAvx2();
+    return avx2 && hashBackend() == HashBackend::OpenSSL;
+#else
+    return false;
+#endif
+}
+
+std::vector<ObjectId> hashObjects(const std::vector<HashInput>& inputs)
+{
+    std::vector<ObjectId> ids(inputs.size());
+
+    // A large object would keep its lane busy long after the others ran
+    // dry, so those are hashed on their own. With fewer small objects than
+    // half the lanes most of the work would be wasted.
+    constexpr size_t LANES = 8;
+    std::vector<size_t> order;
+    const bool batch = multiBufferHashing();
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (batch && inputs[i].content.size() <= MULTI_BUFFER_LIMIT) order.push_back(i);
+        else ids[i] = hashObject(inputs[i].header, inputs[i].content);
+    }
+    if (order.size() < LANES / 2) {
+        for (size_t i : order) ids[i] = hashObject(inputs[i].header, inputs[i].content);
+        return ids;
+    }
+
+#ifdef VIT_SHA1_X86
+    // "<header><content>" and its padding, a block at a time. Blocks wholly
+    // inside the content are read in place; the others are put together
+    // in a scratch block.
+    struct Message {
+        std::string_view header, content;
+        uint64_t         length = 0;
+        size_t           blocks = 0;
+
+        const unsigned char* block(size_t index, unsigned char (&scratch)[64]) const
+        {
+            const uint64_t begin = uint64_t(index) * 64;
+            if (begin >= header.size() && begin + 64 <= length)
+                return reinterpret_cast<const unsigned char*>(content.data()) + (begin - header.size());
+
+            std::memset(scratch, 0, sizeof(scratch));
+            for (size_t i = 0; i < 64 && begin + i <= length; ++i) {
+                const uint64_t pos = begin + i;
+                scratch[i] = pos < header.size() ? static_cast<unsigned char>(header[pos])
+                           : pos < length        ? static_cast<unsigned char>(content[pos - header.size()])
+                           :                       0x80;
+            }
+            if (index == blocks - 1) writeBE64(scratch + 56, length * 8);
+            return scratch;
+        }
+    };
+
+    std::vector<Message> messages(inputs.size());
+    for (size_t i : order) {
+        Message& m = messages[i];
+        m.header  = inputs[i].header;
+        m.content = inputs[i].content;
+        m.length  = m.header.size() + m.content.size();
+        m.blocks  = static_cast<size_t>((m.length + 8) / 64 + 1);
+    }
+
+    // longest first, so lanes run out of work at about the same time
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return messages[a].blocks > messages[b].blocks; });
+
+    alignas(32) uint32_t state[5][LANES];
+    unsigned char        scratch[LANES][64];
+    static const unsigned char idle[64] = {};
+    size_t job[LANES], block[LANES];
+    size_t next = 0, active = 0;
+
+    auto assign = [&](size_t lane) {
+        if (next == order.size()) {
+            job[lane] = SIZE_MAX;
+            return;
+        }
+        job[lane]   = order[next++];
+        block[lane] = 0;
+        for (int i = 0; i < 5; ++i) state[i][lane] = INITIAL_STATE[i];
+        ++active;
+    };
+    for (size_t lane = 0; lane < LANES; ++lane) assign(lane);
+
+    while (active) {
+        const unsigned char* blocks[LANES];
+        for (size_t lane = 0; lane < LANES; ++lane)
+            blocks[lane] = job[lane] == SIZE_MAX ? idle : messages[job[lane]].block(block[lane], scratch[lane]);
+        avx2Blocks8(state, blocks);
+
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            if (job[lane] == SIZE_MAX || ++block[lane] < messages[job[lane]].blocks) continue;
+            uint32_t digest[5];
+            for (int i = 0; i < 5; ++i) digest[i] = state[i][lane];
+            ids[job[lane]] = digestOf(digest);
+            --active;
+            assign(lane);
+        }
+    }
+#endif
+    return ids;
+}
+
+}
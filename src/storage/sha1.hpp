@@ -0,0 +1,75 @@
+#pragma once
+#include "object_id.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace vit::storage {
+
+// SHA-1, which names objects and checksums vit's files. With the SHA
+// extensions of x86-64 (SHA-NI, detected at run time) or ARMv8 (when the
+// compiler targets them) the blocks are compressed here directly;
+// otherwise OpenSSL does the work through a digest fetched once.
+enum class HashBackend { OpenSSL, ShaNi, ArmV8 };
+
+// The fastest backend this CPU supports, unless VIT_SHA1_BACKEND names
+// another one it supports.
+HashBackend hashBackend();
+const char* hashBackendName(HashBackend backend);
+
+// For benchmarks: false, changing nothing, if the CPU or the build lacks
+// `backend`. Hashes already under way keep the backend they started with.
+bool setHashBackend(HashBackend backend);
+
+// Incremental SHA-1 over any number of pieces.
+class Sha1 {
+public:
+    Sha1();
+    ~Sha1();
+    Sha1(const Sha1&)            = delete;
+    Sha1& operator=(const Sha1&) = delete;
+
+    void update(const void* data, size_t size);
+    void update(std::string_view data) { update(data.data(), data.size()); }
+
+    // The digest; the object is spent afterwards.
+    ObjectId finish();
+
+private:
+    HashBackend   backend_;
+    void*         evp_ = nullptr;   // EVP_MD_CTX for the OpenSSL backend
+    uint32_t      state_[5];
+    unsigned char block_[64];
+    size_t        used_   = 0;      // bytes waiting in block_
+    uint64_t      length_ = 0;
+};
+
+// The name of the object "<header><content>", without joining the two.
+ObjectId hashObject(std::string_view header, std::string_view content);
+
+// SHA-1 of one buffer, for file checksums.
+ObjectId hashBytes(const void* data, size_t size);
+
+struct HashInput {
+    std::string_view header;
+    std::string_view content;
+};
+
+// Contents above this size are never hashed side by side with others.
+constexpr size_t MULTI_BUFFER_LIMIT = 64 * 1024;
+
+// hashObject for each input, in order. Where the backend hashes one block
+// at a time in scalar code (no SHA extensions) and the CPU has AVX2, eight
+// objects go through the compression function side by side, one per lane:
+// 1.1x to 1.5x the throughput of one at a time for 1 KiB to 64 KiB
+// objects, depending on the CPU (see bench/hash_bench.cpp). Larger
+// inputs, and batches of fewer than four small ones, are hashed one at a
+// time, since idle lanes would make them slower.
+std::vector<ObjectId> hashObjects(const std::vector<HashInput>& inputs);
+
+// Whether hashObjects runs eight lanes at a time with the current backend.
+bool multiBufferHashing();
+
+}
@@ -0,0 +1,172 @@
+#include "tree_view.hpp"
+#include "object_store.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace vit::storage {
+
+TreeView::TreeView(const ObjectId& treeHash)
+{
+    ObjectType type;
+    content_ = loadObjectShared(treeHash, type);
+}
+
+TreeView::iterator TreeView::begin() const
+{
+    if (!content_ || content_->empty()) return end();
+    return iterator(content_->data(), content_->data() + content_->size());
+}
+
+// Entries are "<octal mode> <name>\0<20-byte id>".
+void TreeView::iterator::advance()
+{
+    pos_ = nullptr;
+    if (!next_ || next_ >= end_) return;
+
+    const char* p     = next_;
+    const auto* space = static_cast<const char*>(std::memchr(p, ' ', end_ - p));
+    if (!space || space == p) return;
+    const auto* nul = static_cast<const char*>(std::memchr(space + 1, '\0', end_ - space - 1));
+    if (!nul || static_cast<size_t>(end_ - nul - 1) < ObjectId::RAW_SIZE) return;
+
+    uint32_t mode = 0;
+    for (const char* m = p; m < space; ++m) {
+        if (*m < '0' || *m > '7') return;
+        mode = mode * 8 + static_cast<uint32_t>(*m - '0');
+    }
+
+    entry_.modeText = std::string_view(p, space - p);
+    entry_.name     = std::string_view(space + 1, nul - space - 1);
+    entry_.mode     = static_cast<TreeMode>(mode);
+    entry_.id       = ObjectId::fromRaw(nul + 1);
+    pos_  = p;
+    next_ = nul + 1 + ObjectId::RAW_SIZE;
+}
+
+
+namespace {
+
+// The entries of `tree` ordered by plain name. vit writes its trees in
+// that order, git sorts a directory as if its name ended in '/', so
+// trees from git are re-sorted; a directory and a file sharing a prefix
+// ("a" and "a.txt") then line up the same on both sides of a diff.
+std::vector<TreeViewEntry> entriesByName(const TreeView& tree)
+{
+    std::vector<TreeViewEntry> entries(tree.begin(), tree.end());
+    auto byName = [](const TreeViewEntry& a, const TreeViewEntry& b) { return a.name < b.name; };
+    if (!std::is_sorted(entries.begin(), entries.end(), byName))
+        std::sort(entries.begin(), entries.end(), byName);
+    return entries;
+}
+
+std::string childPath(const std::string& base, std::string_view name)
+{
+    std::string path;
+    path.reserve(base.size() + 1 + name.size());
+    if (!base.empty()) (path += base) += '/';
+    path += name;
+    return path;
+}
+
+TreeView openTree(const ObjectId& id)
+{
+    return id.isNull() ? TreeView() : TreeView(id);
+}
+
+bool diffLevel(const ObjectId& before, const ObjectId& after, const std::string& base,
+               const TreeDiffVisitor& visit);
+
+// Reports `e` and, for a tree, everything below it as present on one side only.
+bool reportOneSided(const TreeViewEntry& e, const std::string& base, bool added,
+                    const TreeDiffVisitor& visit)
+{
+    const std::string path = childPath(base, e.name);
+    if (e.isDirectory())
+        return added ? diffLevel({}, e.id, path, visit) : diffLevel(e.id, {}, path, visit);
+    return added ? visit(path, nullptr, &e) : visit(path, &e, nullptr);
+}
+
+bool diffLevel(const ObjectId& before, const ObjectId& after, const std::string& base,
+               const TreeDiffVisitor& visit)
+{
+    if (before == after) return true;
+
+    // the views own the bytes the entries point into
+    const TreeView a = openTree(before);
+    const TreeView b = openTree(after);
+    const std::vector<TreeViewEntry> ea = entriesByName(a);
+    const std::vector<TreeViewEntry> eb = entriesByName(b);
+    auto ia = ea.begin(), ib = eb.begin();
+
+    while (ia != ea.end() || ib != eb.end()) {
+        const int cmp = ia == ea.end() ? 1 : ib == eb.end() ? -1 : ia->name.compare(ib->name);
+        if (cmp < 0) {
+            if (!reportOneSided(*ia, base, false, visit)) return false;
+            ++ia;
+        } else if (cmp > 0) {
+            if (!reportOneSided(*ib, base, true, visit)) return false;
+            ++ib;
+        } else {
+            if (ia->isDirectory() != ib->isDirectory()) {
+                // a file replaced by a directory or the other way round
+                if (!reportOneSided(*ia, base, false, visit) ||
+                    !reportOneSided(*ib, base, true, visit))
+                    return false;
+            } else if (ia->isDirectory()) {
+                if (ia->id != ib->id && !diffLevel(ia->id, ib->id, childPath(base, ia->name), visit))
+                    return false;
+            } else if (ia->id != ib->id || ia->mode != ib->mode) {
+                if (!visit(childPath(base, ia->name), &*ia, &*ib)) return false;
+            }
+            ++ia;
+            ++ib;
+        }
+    }
+    return true;
+}
+
+bool findEntry(const ObjectId& tree, std::string_view name, TreeViewEntry& out)
+{
+    if (tree.isNull()) return false;
+    for (const auto& e : TreeView(tree)) {
+        if (e.name == name) {
+            out = e;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool diffTrees(const ObjectId& before, const ObjectId& after, const TreeDiffVisitor& visit)
+{
+    return diffLevel(before, after, "", visit);
+}
+
+bool pathChanged(const ObjectId& before, const ObjectId& after, std::string_view path)
+{
+    ObjectId a = before, b = after;
+    while (true) {
+        if (a == b) return false;
+
+        const size_t      slash = path.find('/');
+        const std::string_view name = path.substr(0, slash);
+        TreeViewEntry ea, eb;
+        const bool inA = findEntry(a, name, ea);
+        const bool inB = findEntry(b, name, eb);
+        if (slash == std::string_view::npos) {
+            if (inA != inB) return true;
+            return inA && (ea.id != eb.id || ea.mode != eb.mode);
+        }
+
+        // a missing entry or a non-directory has nothing below it
+        a = inA && ea.isDirectory() ? ea.id : ObjectId();
+        b = inB && eb.isDirectory() ? eb.id : ObjectId();
+        path = path.substr(slash + 1);
+    }
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include "object_id.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace vit::storage {
+
+// Modes git writes into tree entries. Anything else is passed through as
+// its numeric value.
+enum class TreeMode : uint32_t {
+    Tree       = 040000,
+    Blob       = 0100644,
+    Executable = 0100755,
+    Symlink    = 0120000,
+    Gitlink    = 0160000
+};
+
+struct TreeViewEntry {
+    std::string_view name;
+    std::string_view modeText;   // as stored, e.g. "40000"
+    TreeMode         mode = TreeMode::Blob;
+    ObjectId         id;
+
+    bool isDirectory() const { return mode == TreeMode::Tree; }
+};
+
+// Walks the entries of an inflated tree object in place: names and modes
+// are views into the object buffer, which the view keeps alive, so
+// iterating allocates nothing. A malformed entry ends the iteration.
+class TreeView {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = TreeViewEntry;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const TreeViewEntry*;
+        using reference         = const TreeViewEntry&;
+
+        iterator() = default;
+        iterator(const char* pos, const char* end) : next_(pos), end_(end) { advance(); }
+
+        reference operator*() const  { return entry_; }
+        pointer   operator->() const { return &entry_; }
+        iterator& operator++()       { advance(); return *this; }
+        iterator  operator++(int)    { iterator old = *this; advance(); return old; }
+
+        friend bool operator==(const iterator& a, const iterator& b) { return a.pos_ == b.pos_; }
+
+    private:
+        void advance();
+
+        const char*   pos_  = nullptr;   // start of the current entry, null at the end
+        const char*   next_ = nullptr;
+        const char*   end_  = nullptr;
+        TreeViewEntry entry_;
+    };
+
+    TreeView() = default;
+    explicit TreeView(const ObjectId& treeHash);   // through the object cache
+    explicit TreeView(std::shared_ptr<const std::string> content) : content_(std::move(content)) {}
+
+    // False if the object could not be read.
+    bool valid() const { return content_ != nullptr; }
+
+    iterator begin() const;
+    iterator end() const { return {}; }
+
+private:
+    std::shared_ptr<const std::string> content_;
+};
+
+// Called for every non-tree path that differs between two trees: added
+// (`before` null), removed (`after` null), or changed in id or mode.
+// Returning false stops the walk.
+using TreeDiffVisitor = std::function<bool(const std::string& path, const TreeViewEntry* before,
+                                           const TreeViewEntry* after)>;
+
+// Walks both trees side by side in plain name order, the order vit writes
+// trees in (trees from git are re-sorted to match). Subtrees with equal
+// ids are skipped without being read; an added or removed subtree is
+// expanded into its files. A null id stands for the empty tree. Returns
+// false if `visit` stopped the walk.
+bool diffTrees(const ObjectId& before, const ObjectId& after, const TreeDiffVisitor& visit);
+
+// Whether the entry at `path` ("dir/file", no trailing slash) differs
+// between two trees, counting an entry present in only one of them.
+// Descends one component at a time and stops as soon as the subtrees on
+// both sides have the same id.
+bool pathChanged(const ObjectId& before, const ObjectId& after, std::string_view path);
+
+}
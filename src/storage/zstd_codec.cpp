@@ -0,0 +1,377 @@
+#include "zstd_codec.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+
+#ifdef VIT_HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+namespace vit::storage {
+
+namespace {
+
+constexpr unsigned char ZSTD_MAGIC[4] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+#ifdef VIT_HAVE_ZSTD
+
+const std::string DICTIONARY_DIR = ".git/objects/info/zstd";
+// zstd's own suggestion is ~100 KiB; trees and commits need far less
+constexpr size_t DICTIONARY_SIZE = 32 * 1024;
+
+// The zstd level for a zlib-style level; see zstd_codec.hpp.
+int zstdLevel(int level)
+{
+    if (level < 0) return ZSTD_CLEVEL_DEFAULT;
+    // zstd has no stored mode: its fastest level barely searches for
+    // matches, and blocks that do not shrink are kept raw
+    if (level == 0) return ZSTD_minCLevel();
+    return level;
+}
+
+std::string dictionaryPath(unsigned id)
+{
+    return DICTIONARY_DIR + '/' + std::to_string(id) + ".dict";
+}
+
+bool readFile(const std::string& path, std::string& out)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+    out.assign(std::istreambuf_iterator<char>(f), {});
+    return true;
+}
+
+bool writeFile(const std::string& path, const std::string& data)
+{
+    const std::string tmpPath = path + ".tmp" + std::to_string(::getpid());
+    std::error_code ec;
+    {
+        std::ofstream f(tmpPath, std::ios::binary);
+        if (!f.write(data.data(), data.size())) {
+            f.close();
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+struct CDictDeleter { void operator()(ZSTD_CDict* d) const { ZSTD_freeCDict(d); } };
+struct DDictDeleter { void operator()(ZSTD_DDict* d) const { ZSTD_freeDDict(d); } };
+struct CCtxDeleter  { void operator()(ZSTD_CCtx* c)  const { ZSTD_freeCCtx(c); } };
+
+// The dictionaries of the repository, read on first use. zstd lets any
+// number of threads share a digested dictionary.
+class Dictionaries {
+public:
+    static Dictionaries& instance()
+    {
+        static Dictionaries dictionaries;
+        return dictionaries;
+    }
+
+    // The dictionary with id `id`, or nullptr if it is missing.
+    const ZSTD_DDict* decoding(unsigned id)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = ddicts_.find(id);
+        if (it == ddicts_.end()) {
+            std::string bytes;
+            ZSTD_DDict* d = readFile(dictionaryPath(id), bytes)
+                          ? ZSTD_createDDict(bytes.data(), bytes.size()) : nullptr;
+            it = ddicts_.emplace(id, std::unique_ptr<ZSTD_DDict, DDictDeleter>(d)).first;
+        }
+        return it->second.get();
+    }
+
+    // The current dictionary prepared for `level`, or nullptr if none
+    // has been trained.
+    const ZSTD_CDict* encoding(int level)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        load();
+        if (current_.empty()) return nullptr;
+        auto& d = cdicts_[level];
+        if (!d) d.reset(ZSTD_createCDict(current_.data(), current_.size(), level));
+        return d.get();
+    }
+
+    bool hasCurrent()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        load();
+        return !current_.empty();
+    }
+
+    // After a new dictionary was made current. Not safe while other
+    // threads are compressing.
+    void reload()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loaded_ = false;
+        current_.clear();
+        cdicts_.clear();
+        ddicts_.clear();
+    }
+
+private:
+    Dictionaries() = default;
+
+    void load()
+    {
+        if (loaded_) return;
+        loaded_ = true;
+        std::string name;
+        if (!readFile(DICTIONARY_DIR + "/current", name) ||
+            !readFile(dictionaryPath(std::strtoul(name.c_str(), nullptr, 10)), current_))
+            current_.clear();
+    }
+
+    std::mutex                                                        mutex_;
+    bool                                                              loaded_ = false;
+    std::string                                                       current_;
+    std::map<int, std::unique_ptr<ZSTD_CDict, CDictDeleter>>          cdicts_;
+    std::map<unsigned, std::unique_ptr<ZSTD_DDict, DDictDeleter>>     ddicts_;
+};
+
+// Decompression contexts are costly to set up and objects are read one
+// after another, so each thread keeps the ones it is done with.
+struct DCtxPool {
+    std::vector<ZSTD_DCtx*> free;
+    ~DCtxPool() { for (ZSTD_DCtx* c : free) ZSTD_freeDCtx(c); }
+};
+thread_local DCtxPool dctxPool;
+
+ZSTD_DCtx* acquireDCtx()
+{
+    if (dctxPool.free.empty()) return ZSTD_createDCtx();
+    ZSTD_DCtx* c = dctxPool.free.back();
+    dctxPool.free.pop_back();
+    return c;
+}
+
+void releaseDCtx(ZSTD_DCtx* c)
+{
+    ZSTD_DCtx_reset(c, ZSTD_reset_session_and_parameters);
+    dctxPool.free.push_back(c);
+}
+
+#else
+
+bool unavailable()
+{
+    std::cerr << "vit was built without zstd support\n";
+    return false;
+}
+
+#endif
+
+} // namespace
+
+bool zstdAvailable()
+{
+#ifdef VIT_HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool isZstdFrame(const unsigned char* data, size_t size)
+{
+    return size >= sizeof(ZSTD_MAGIC) && std::memcmp(data, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)) == 0;
+}
+
+bool zstdCompress(std::string_view data, int level, std::string& out)
+{
+#ifdef VIT_HAVE_ZSTD
+    thread_local std::unique_ptr<ZSTD_CCtx, CCtxDeleter> cctx(ZSTD_createCCtx());
+    level = zstdLevel(level);
+
+    const ZSTD_CDict* dict = data.size() <= DICTIONARY_LIMIT ? Dictionaries::instance().encoding(level)
+                                                             : nullptr;
+    out.resize(ZSTD_compressBound(data.size()));
+    const size_t n = dict
+        ? ZSTD_compress_usingCDict(cctx.get(), out.data(), out.size(), data.data(), data.size(), dict)
+        : ZSTD_compressCCtx(cctx.get(), out.data(), out.size(), data.data(), data.size(), level);
+    if (ZSTD_isError(n)) {
+        std::cerr << "zstd: " << ZSTD_getErrorName(n) << '\n';
+        return false;
+    }
+    out.resize(n);
+    return true;
+#else
+    (void)data, (void)level, (void)out;
+    return unavailable();
+#endif
+}
+
+
+ZstdEncoder::~ZstdEncoder()
+{
+#ifdef VIT_HAVE_ZSTD
+    ZSTD_freeCCtx(static_cast<ZSTD_CCtx*>(ctx_));
+#endif
+}
+
+bool ZstdEncoder::begin(int level)
+{
+#ifdef VIT_HAVE_ZSTD
+    auto* c = ZSTD_createCCtx();
+    ctx_ = c;
+    return c && !ZSTD_isError(ZSTD_CCtx_setParameter(c, ZSTD_c_compressionLevel, zstdLevel(level)));
+#else
+    (void)level;
+    return unavailable();
+#endif
+}
+
+bool ZstdEncoder::update(const void* data, size_t size, bool finish, std::string& out)
+{
+#ifdef VIT_HAVE_ZSTD
+    auto* c = static_cast<ZSTD_CCtx*>(ctx_);
+    thread_local std::string buf(ZSTD_CStreamOutSize(), '\0');
+    ZSTD_inBuffer in{ data, size, 0 };
+    for (;;) {
+        ZSTD_outBuffer o{ buf.data(), buf.size(), 0 };
+        const size_t left = ZSTD_compressStream2(c, &o, &in, finish ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError(left)) {
+            std::cerr << "zstd: " << ZSTD_getErrorName(left) << '\n';
+            return false;
+        }
+        out.append(buf.data(), o.pos);
+        if (finish ? left == 0 : in.pos == in.size) return true;
+    }
+#else
+    (void)data, (void)size, (void)finish, (void)out;
+    return unavailable();
+#endif
+}
+
+
+ZstdDecoder::~ZstdDecoder()
+{
+#ifdef VIT_HAVE_ZSTD
+    if (ctx_) releaseDCtx(static_cast<ZSTD_DCtx*>(ctx_));
+#endif
+}
+
+bool ZstdDecoder::begin(const unsigned char* data, size_t size)
+{
+#ifdef VIT_HAVE_ZSTD
+    data_ = data;
+    size_ = size;
+    pos_  = 0;
+    auto* c = acquireDCtx();
+    ctx_ = c;
+    if (!c) return false;
+
+    if (const unsigned id = ZSTD_getDictID_fromFrame(data, size)) {
+        const ZSTD_DDict* dict = Dictionaries::instance().decoding(id);
+        if (!dict) {
+            std::cerr << "Missing zstd dictionary " << id << " in " << DICTIONARY_DIR << '\n';
+            return false;
+        }
+        ZSTD_DCtx_refDDict(c, dict);
+    }
+    return true;
+#else
+    (void)data, (void)size;
+    return unavailable();
+#endif
+}
+
+bool ZstdDecoder::read(char* out, size_t capacity, size_t& produced, bool& done)
+{
+#ifdef VIT_HAVE_ZSTD
+    ZSTD_inBuffer  in{ data_, size_, pos_ };
+    ZSTD_outBuffer o{ out, capacity, 0 };
+    done = false;
+    for (;;) {
+        const size_t ret = ZSTD_decompressStream(static_cast<ZSTD_DCtx*>(ctx_), &o, &in);
+        if (ZSTD_isError(ret)) {
+            std::cerr << "zstd: " << ZSTD_getErrorName(ret) << '\n';
+            return false;
+        }
+        if (ret == 0) {
+            done = true;
+            break;
+        }
+        if (o.pos == o.size) break;
+        // input used up and room left over: the frame was cut short
+        if (in.pos == in.size) {
+            std::cerr << "zstd: truncated frame\n";
+            return false;
+        }
+    }
+    pos_     = in.pos;
+    produced = o.pos;
+    return true;
+#else
+    (void)out, (void)capacity, (void)produced, (void)done;
+    return unavailable();
+#endif
+}
+
+
+bool hasZstdDictionary()
+{
+#ifdef VIT_HAVE_ZSTD
+    return Dictionaries::instance().hasCurrent();
+#else
+    return false;
+#endif
+}
+
+bool trainZstdDictionary(const std::vector<std::string>& samples, std::string* error)
+{
+#ifdef VIT_HAVE_ZSTD
+    std::string         buffer;
+    std::vector<size_t> sizes;
+    sizes.reserve(samples.size());
+    for (const auto& s : samples) {
+        buffer += s;
+        sizes.push_back(s.size());
+    }
+
+    // a dictionary much larger than a tenth of the samples is mostly noise
+    const size_t capacity = std::clamp<size_t>(buffer.size() / 10, 1024, DICTIONARY_SIZE);
+    std::string  dict(capacity, '\0');
+    const size_t n = ZDICT_trainFromBuffer(dict.data(), dict.size(), buffer.data(), sizes.data(),
+                                           static_cast<unsigned>(sizes.size()));
+    if (ZDICT_isError(n)) {
+        if (error) *error = std::string("cannot train a zstd dictionary: ") + ZDICT_getErrorName(n);
+        return false;
+    }
+    dict.resize(n);
+
+    const unsigned id = ZDICT_getDictID(dict.data(), dict.size());
+    std::error_code ec;
+    std::filesystem::create_directories(DICTIONARY_DIR, ec);
+    if (!id || !writeFile(dictionaryPath(id), dict) ||
+        !writeFile(DICTIONARY_DIR + "/current", std::to_string(id) + '\n')) {
+        if (error) *error = "cannot write the zstd dictionary";
+        return false;
+    }
+    Dictionaries::instance().reload();
+    return true;
+#else
+    (void)samples;
+    if (error) *error = "vit was built without zstd support";
+    return false;
+#endif
+}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vit::storage {
+
+// zstd for the loose objects of repositories created with
+// `vit init --object-compression=zstd`. Objects up to DICTIONARY_LIMIT
+// bytes are compressed with the current dictionary in
+// .git/objects/info/zstd/, where each dictionary is kept as <id>.dict and
+// "current" names the one new objects use. Older dictionaries stay for
+// the objects written with them; every frame records the one it needs.
+//
+// Without VIT_HAVE_ZSTD everything here fails with a message.
+
+constexpr size_t DICTIONARY_LIMIT = 128 * 1024;
+
+bool zstdAvailable();
+
+// True if `data` starts with a zstd frame rather than a zlib stream.
+bool isZstdFrame(const unsigned char* data, size_t size);
+
+// Compresses a whole object, header included, into one frame. `level` is
+// the zlib-style level of compression.hpp, mapped as: -1 (zlib's default)
+// to zstd's default, 3; 0 (stored) to zstd's fastest negative level, as
+// close to storing as zstd gets; 1 to 9 to the same zstd level.
+bool zstdCompress(std::string_view data, int level, std::string& out);
+
+// Compresses an object that is fed in pieces, without a dictionary.
+class ZstdEncoder {
+public:
+    ZstdEncoder() = default;
+    ~ZstdEncoder();
+    ZstdEncoder(const ZstdEncoder&)            = delete;
+    ZstdEncoder& operator=(const ZstdEncoder&) = delete;
+
+    // `level` as for zstdCompress().
+    bool begin(int level);
+
+    // Appends what `data` compresses to so far to `out`; `finish` ends the
+    // frame after it.
+    bool update(const void* data, size_t size, bool finish, std::string& out);
+
+private:
+    void* ctx_ = nullptr;
+};
+
+// Decompresses the frame at the start of `data` in pieces.
+class ZstdDecoder {
+public:
+    ZstdDecoder() = default;
+    ~ZstdDecoder();
+    ZstdDecoder(const ZstdDecoder&)            = delete;
+    ZstdDecoder& operator=(const ZstdDecoder&) = delete;
+
+    // Fails if the frame needs a dictionary that is missing.
+    bool begin(const unsigned char* data, size_t size);
+
+    // Fills up to `capacity` bytes of `out`; `done` is set once the frame
+    // is complete. False if the frame is corrupt or cut short.
+    bool read(char* out, size_t capacity, size_t& produced, bool& done);
+
+private:
+    void*                ctx_  = nullptr;
+    const unsigned char* data_ = nullptr;
+    size_t               size_ = 0;
+    size_t               pos_  = 0;
+};
+
+// Whether a dictionary has been trained for this repository.
+bool hasZstdDictionary();
+
+// Trains a dictionary from `samples` (whole small objects, header
+// included) and makes it current.
+bool trainZstdDictionary(const std::vector<std::string>& samples, std::string* error = nullptr);
+
+}
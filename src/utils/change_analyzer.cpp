@@ -8,14 +8,14 @@ namespace vit::utils {
 ChangeAnalyzer::ChangeAnalyzer(std::shared_ptr<vit::ai::AIClient> aiClient)
     : aiClient_(aiClient) {}
 
-ChangeAnalyzer::AnalysisResult ChangeAnalyzer::analyzeChanges(const std::string& commitHash, bool sourceOnly) {
+ChangeAnalyzer::AnalysisResult ChangeAnalyzer::analyzeChanges(const ObjectId& commitHash, bool sourceOnly) {
     AnalysisResult result;
     size_t currentTokens = 0;
     
     // Get target commit (default to HEAD)
-    std::string targetCommit = commitHash.empty() ? readHead() : commitHash;
+    const ObjectId targetCommit = commitHash.isNull() ? readHead() : commitHash;
     
-    if (targetCommit.empty()) {
+    if (targetCommit.isNull()) {
         // No commits yet - everything is new
         auto workingFiles = getWorkingDirectoryFiles();
         for (const std::string& filePath : workingFiles) {
@@ -38,8 +38,8 @@ ChangeAnalyzer::AnalysisResult ChangeAnalyzer::analyzeChanges(const std::string&
     }
     
     CommitInfo commitInfo = parseCommit(targetCommit);
-    if (commitInfo.hash.empty()) {
-        throw std::runtime_error("Invalid commit: " + targetCommit);
+    if (commitInfo.hash.isNull()) {
+        throw std::runtime_error("Invalid commit: " + targetCommit.hex());
     }
     
     auto commitFiles = getCommitFileMap(commitInfo.treeHash); // these are the files from the last commit
@@ -102,48 +102,49 @@ ChangeAnalyzer::AnalysisResult ChangeAnalyzer::analyzeChanges(const std::string&
     return result;
 }
 
-std::string ChangeAnalyzer::getFileContentFromCommit(const std::string& filePath, const std::string& treeHash) {
+std::string ChangeAnalyzer::getFileContentFromCommit(const std::string& filePath, const ObjectId& treeHash) {
     return findFileInTree(treeHash, filePath);
 }
 
-std::string ChangeAnalyzer::findFileInTree(const std::string& treeHash, const std::string& filePath) {
-    auto files = parseTree(treeHash);
+std::string ChangeAnalyzer::findFileInTree(const ObjectId& treeHash, const std::string& filePath) {
+    const vit::storage::TreeView tree(treeHash);
     
     // Handle root level files
-    for (const auto& file : files) {
-        if (file.name == filePath && !file.isDirectory) {
-            return readObjectContent(file.hash);
+    for (const auto& file : tree) {
+        if (file.name == filePath && !file.isDirectory()) {
+            return readObjectContent(file.id);
         }
     }
     
     // Handle nested files
-    for (const auto& file : files) {
-        if (file.isDirectory && filePath.starts_with(file.name + "/")) {
+    for (const auto& file : tree) {
+        if (file.isDirectory() && filePath.size() > file.name.size() &&
+            filePath.starts_with(file.name) && filePath[file.name.size()] == '/') {
             std::string remainingPath = filePath.substr(file.name.length() + 1);
-            return findFileInTree(file.hash, remainingPath);
+            return findFileInTree(file.id, remainingPath);
         }
     }
     
     return "";  // File not found
 }
 
-std::unordered_map<std::string, std::string> ChangeAnalyzer::getCommitFileMap(const std::string& treeHash) {
-    std::unordered_map<std::string, std::string> fileMap;
+std::unordered_map<std::string, ObjectId> ChangeAnalyzer::getCommitFileMap(const ObjectId& treeHash) {
+    std::unordered_map<std::string, ObjectId> fileMap;
     collectTreeFileMap(treeHash, "", fileMap);
     return fileMap;
 }
 
-void ChangeAnalyzer::collectTreeFileMap(const std::string& treeHash, const std::string& basePath, 
-                                       std::unordered_map<std::string, std::string>& fileMap) {
-    auto files = parseTree(treeHash);
-    
-    for (const auto& file : files) {
-        std::string fullPath = basePath.empty() ? file.name : basePath + "/" + file.name;
+void ChangeAnalyzer::collectTreeFileMap(const ObjectId& treeHash, const std::string& basePath, 
+                                       std::unordered_map<std::string, ObjectId>& fileMap) {
+    for (const auto& file : vit::storage::TreeView(treeHash)) {
+        std::string fullPath = basePath;
+        if (!fullPath.empty()) fullPath += '/';
+        fullPath += file.name;
         
-        if (file.isDirectory) {
-            collectTreeFileMap(file.hash, fullPath, fileMap);
+        if (file.isDirectory()) {
+            collectTreeFileMap(file.id, fullPath, fileMap);
         } else {
-            fileMap[fullPath] = file.hash;
+            fileMap[std::move(fullPath)] = file.id;
         }
     }
 }
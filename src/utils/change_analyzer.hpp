@@ -1,5 +1,6 @@
 #pragma once
 #include "../commit.hpp"
+#include "../storage/tree_view.hpp"
 #include "../utils/file_utils.hpp"
 #include <string>
 #include <vector>
@@ -39,18 +40,18 @@ public:
 
     explicit ChangeAnalyzer(std::shared_ptr<vit::ai::AIClient> aiClient);
 
-    AnalysisResult analyzeChanges(const std::string& commitHash = "", bool sourceOnly = true);
+    AnalysisResult analyzeChanges(const ObjectId& commitHash = {}, bool sourceOnly = true);
 
 private:
     std::shared_ptr<vit::ai::AIClient> aiClient_;
 
-    std::string getFileContentFromCommit(const std::string& filePath, const std::string& treeHash);
-    std::unordered_map<std::string, std::string> getCommitFileMap(const std::string& treeHash);
+    std::string getFileContentFromCommit(const std::string& filePath, const ObjectId& treeHash);
+    std::unordered_map<std::string, ObjectId> getCommitFileMap(const ObjectId& treeHash);
     std::vector<std::string> getWorkingDirectoryFiles();
     
-    std::string findFileInTree(const std::string& treeHash, const std::string& filePath);
-    void collectTreeFileMap(const std::string& treeHash, const std::string& basePath, 
-                           std::unordered_map<std::string, std::string>& fileMap);
+    std::string findFileInTree(const ObjectId& treeHash, const std::string& filePath);
+    void collectTreeFileMap(const ObjectId& treeHash, const std::string& basePath, 
+                           std::unordered_map<std::string, ObjectId>& fileMap);
     std::string normalizeFilePath(const std::string& path);
 };
 
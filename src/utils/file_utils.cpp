@@ -5,6 +5,7 @@
 #include <sstream>
 #include <iostream>
 #include <set>
+#include <algorithm>
 
 namespace vit::utils {
 
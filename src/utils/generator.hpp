@@ -0,0 +1,114 @@
+#pragma once
+#include <version>
+
+#if defined(__cpp_lib_generator)
+#include <generator>
+#else
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+#endif
+
+namespace vit::utils {
+
+#if defined(__cpp_lib_generator)
+
+template <typename T>
+using Generator = std::generator<T>;
+
+#else
+
+// Stand-in for C++23 std::generator on standard libraries that do not ship
+// it yet: a coroutine that produces values with `co_yield`, one at a time,
+// as the caller advances. Nothing runs before the first begin(), and
+// destroying the generator abandons the rest of the sequence. Single pass;
+// a yielded value lives until the next increment.
+template <typename T>
+class Generator {
+public:
+    struct promise_type {
+        const T*           current = nullptr;
+        std::exception_ptr error;
+
+        Generator get_return_object()
+        {
+            return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+
+        // the yielded object stays alive while the coroutine is suspended
+        std::suspend_always yield_value(const T& value) noexcept
+        {
+            current = std::addressof(value);
+            return {};
+        }
+
+        void return_void() noexcept {}
+        void unhandled_exception() { error = std::current_exception(); }
+
+        template <typename U>
+        std::suspend_never await_transform(U&&) = delete;   // generators do not co_await
+    };
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(std::coroutine_handle<promise_type> h) : handle_(h) {}
+
+        const T&  operator*() const { return *handle_.promise().current; }
+        const T*  operator->() const { return handle_.promise().current; }
+        iterator& operator++()      { resume(handle_); return *this; }
+        void      operator++(int)   { ++*this; }
+
+        friend bool operator==(const iterator& it, std::default_sentinel_t)
+        {
+            return !it.handle_ || it.handle_.done();
+        }
+
+    private:
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    Generator(Generator&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    Generator& operator=(Generator&& other) noexcept
+    {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    Generator(const Generator&)            = delete;
+    Generator& operator=(const Generator&) = delete;
+    ~Generator() { if (handle_) handle_.destroy(); }
+
+    iterator begin()
+    {
+        resume(handle_);
+        return iterator(handle_);
+    }
+    std::default_sentinel_t end() const { return {}; }
+
+private:
+    explicit Generator(std::coroutine_handle<promise_type> h) : handle_(h) {}
+
+    static void resume(std::coroutine_handle<promise_type> h)
+    {
+        if (!h || h.done()) return;
+        h.resume();
+        if (auto error = std::exchange(h.promise().error, nullptr)) std::rethrow_exception(error);
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+#endif
+
+}
@@ -0,0 +1,131 @@
+#include "thread_pool.hpp"
+
+#include <atomic>
+
+namespace vit::utils {
+
+namespace {
+
+std::atomic<size_t> configuredThreads{0};
+
+// Which pool and deque the current thread works for, if any.
+thread_local const ThreadPool* currentPool  = nullptr;
+thread_local size_t            currentIndex = 0;
+
+}
+
+size_t workerThreads()
+{
+    const size_t configured = configuredThreads.load(std::memory_order_relaxed);
+    if (configured) return configured;
+    const size_t cores = std::thread::hardware_concurrency();
+    return cores ? cores : 1;
+}
+
+void setWorkerThreads(size_t threads)
+{
+    configuredThreads.store(threads, std::memory_order_relaxed);
+}
+
+ThreadPool::ThreadPool(size_t threads)
+{
+    if (threads == 0) threads = workerThreads();
+    for (size_t i = 0; i < threads; ++i) queues_.push_back(std::make_unique<Queue>());
+    for (size_t i = 0; i < threads; ++i) workers_.emplace_back(&ThreadPool::run, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return pending_ == 0; });
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    size_t index;
+    if (currentPool == this) {
+        index = currentIndex;
+    } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        index = next_++ % queues_.size();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++queued_;
+        ++pending_;
+    }
+    wake_.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return pending_ == 0; });
+    if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+bool ThreadPool::take(size_t index, std::function<void()>& task)
+{
+    {
+        Queue& own = *queues_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues_.size(); ++i) {
+        Queue& victim = *queues_[(index + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(size_t index)
+{
+    currentPool  = this;
+    currentIndex = index;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return queued_ > 0 || stop_; });
+            if (stop_ && queued_ == 0) return;
+        }
+
+        std::function<void()> task;
+        if (!take(index, task)) continue;   // another worker got there first
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --queued_;
+        }
+
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) error_ = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--pending_ == 0) idle_.notify_all();
+    }
+}
+
+}
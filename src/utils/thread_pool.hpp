@@ -0,0 +1,63 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace vit::utils {
+
+// Number of workers pools get when none is given: the `threads` config
+// value, or one per core when that is 0.
+size_t workerThreads();
+void   setWorkerThreads(size_t threads);
+
+// Fixed set of workers, each owning a deque of tasks. A task submitted from
+// inside a worker goes onto that worker's own deque and is taken back LIFO,
+// which keeps a recursive walk depth-first and cache-warm; idle workers
+// steal FIFO from the others, so the oldest (usually largest) pieces of
+// work get spread out first.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Blocks until every submitted task, including ones submitted by other
+    // tasks, has finished. Rethrows the first exception a task threw.
+    void wait();
+
+    size_t size() const { return workers_.size(); }
+
+private:
+    struct Queue {
+        std::mutex                        mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void run(size_t index);
+    bool take(size_t index, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread>            workers_;
+
+    std::mutex              mutex_;      // guards everything below
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    size_t                  queued_  = 0;   // tasks sitting in some deque
+    size_t                  pending_ = 0;   // queued or running
+    size_t                  next_    = 0;   // round robin for outside submits
+    bool                    stop_    = false;
+    std::exception_ptr      error_;
+};
+
+}